@@ -0,0 +1,99 @@
+#include "address_index.h"
+#include <algorithm>
+#include <set>
+
+namespace
+{
+	template <typename T>
+	size_t to_eytzinger(const std::vector<T>& sorted, std::vector<T>& eytzinger, size_t i, size_t k)
+	{
+		if (k < eytzinger.size())
+		{
+			i = ::to_eytzinger(sorted, eytzinger, i, 2 * k);
+			eytzinger[k] = sorted[i++];
+			i = ::to_eytzinger(sorted, eytzinger, i, 2 * k + 1);
+		}
+		return i;
+	}
+}
+
+AddressIndex::AddressIndex(const std::vector<Range>& ranges)
+{
+	// Sweep through range boundaries keeping track of the ranges covering the current address.
+	std::vector<std::pair<uint64_t, size_t>> events; // Boundary and range priority, ends come with the highest bit set.
+	events.reserve(ranges.size() * 2);
+	for (size_t i = 0; i < ranges.size(); ++i)
+	{
+		if (ranges[i].base >= ranges[i].end)
+			continue;
+		events.emplace_back(ranges[i].base, i);
+		events.emplace_back(ranges[i].end, i | ~(SIZE_MAX >> 1));
+	}
+	std::sort(events.begin(), events.end());
+
+	std::vector<uint64_t> boundaries;
+	std::vector<size_t> values; // Value of the range ending at each boundary.
+	std::multiset<size_t> active;
+	auto current = None;
+	for (auto i = events.begin(); i != events.end(); )
+	{
+		const auto boundary = i->first;
+		for (; i != events.end() && i->first == boundary; ++i)
+		{
+			if (i->second & ~(SIZE_MAX >> 1))
+				active.erase(active.find(i->second & (SIZE_MAX >> 1)));
+			else
+				active.emplace(i->second);
+		}
+		const auto next = active.empty() ? None : ranges[*active.begin()].value;
+		if (next == current)
+			continue;
+		boundaries.emplace_back(boundary);
+		values.emplace_back(current);
+		current = next;
+	}
+
+	_boundaries.resize(boundaries.size() + 1);
+	_values.resize(values.size() + 1);
+	::to_eytzinger(boundaries, _boundaries, 0, 1);
+	::to_eytzinger(values, _values, 0, 1);
+}
+
+size_t AddressIndex::find(uint64_t address) const
+{
+	// Find the first boundary greater than the address, its range is the one containing the address.
+	size_t k = 1;
+	while (k < _boundaries.size())
+		k = 2 * k + (_boundaries[k] <= address);
+	k >>= __builtin_ffsll(~k);
+	return k ? _values[k] : None;
+}
+
+void AddressIndex::find(const uint64_t* addresses, size_t count, size_t* values) const
+{
+	// Independent searches are advanced in lockstep so that their cache misses overlap.
+	static const size_t batch_size = 8;
+	for (size_t base = 0; base < count; base += batch_size)
+	{
+		const auto size = std::min(batch_size, count - base);
+		size_t k[batch_size];
+		std::fill_n(k, size, 1);
+		for (bool done = false; !done; )
+		{
+			done = true;
+			for (size_t i = 0; i < size; ++i)
+			{
+				if (k[i] < _boundaries.size())
+				{
+					k[i] = 2 * k[i] + (_boundaries[k[i]] <= addresses[base + i]);
+					done = false;
+				}
+			}
+		}
+		for (size_t i = 0; i < size; ++i)
+		{
+			k[i] >>= __builtin_ffsll(~k[i]);
+			values[base + i] = k[i] ? _values[k[i]] : None;
+		}
+	}
+}
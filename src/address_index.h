@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Maps addresses to values of the address ranges containing them.
+class AddressIndex
+{
+public:
+
+	static constexpr size_t None = SIZE_MAX;
+
+	struct Range
+	{
+		uint64_t base = 0;
+		uint64_t end = 0;
+		size_t   value = None;
+	};
+
+	AddressIndex() = default;
+
+	// Builds the index, earlier ranges take priority over later overlapping ones.
+	explicit AddressIndex(const std::vector<Range>&);
+
+	// Returns the value of the range containing the address or None.
+	size_t find(uint64_t address) const;
+
+	// Finds values for a batch of addresses, interleaving the lookups.
+	void find(const uint64_t* addresses, size_t count, size_t* values) const;
+
+private:
+
+	// Sorted range boundaries are stored in Eytzinger (breadth-first) layout starting at index 1,
+	// so the search is branchless and the hot top levels of the implicit tree share cache lines.
+	// Each boundary is paired with the value of the range that ends at it.
+	std::vector<uint64_t> _boundaries;
+	std::vector<size_t> _values;
+};
@@ -0,0 +1,90 @@
+#include "batch.h"
+#include "check.h"
+#include "minidump.h"
+#include "parallel.h"
+#include "processor.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <dirent.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+std::vector<std::string> expand_dump_paths(const std::vector<std::string>& paths)
+{
+	std::vector<std::string> result;
+	for (const auto& path : paths)
+	{
+		struct ::stat stat;
+		const auto directory = ::stat(path.c_str(), &stat) == 0 && S_ISDIR(stat.st_mode) ? ::opendir(path.c_str()) : nullptr;
+		if (!directory)
+		{
+			result.emplace_back(path); // Paths that aren't dumps are reported when they fail to load.
+			continue;
+		}
+		std::vector<std::string> files;
+		while (const auto entry = ::readdir(directory))
+		{
+			const auto name_size = ::strlen(entry->d_name);
+			if (name_size <= 4 || ::strcasecmp(entry->d_name + name_size - 4, ".dmp") != 0)
+				continue;
+			auto file_path = path + '/' + entry->d_name;
+			if (::stat(file_path.c_str(), &stat) == 0 && S_ISREG(stat.st_mode))
+				files.emplace_back(std::move(file_path));
+		}
+		::closedir(directory);
+		std::sort(files.begin(), files.end());
+		result.insert(result.end(), files.begin(), files.end());
+	}
+	return result;
+}
+
+size_t process_batch(const std::vector<std::string>& paths, const std::string& commands, const std::shared_ptr<const Symbols>& symbols, bool use_index, std::ostream& output)
+{
+	const auto dump_paths = ::expand_dump_paths(paths);
+	const auto content = Processor(output, output).content(commands);
+
+	// Each dump is processed by a single thread, so nested parallel work runs sequentially.
+	// Blocks are written as soon as all preceding ones are ready.
+	std::mutex mutex;
+	std::vector<std::string> blocks(dump_paths.size());
+	std::vector<bool> ready(dump_paths.size(), false);
+	size_t next_block = 0;
+	std::atomic<size_t> failures{0};
+	::parallel_for(dump_paths.size(), [&](size_t index)
+	{
+		std::ostringstream block;
+		block << "== " << dump_paths[index] << '\n';
+		try
+		{
+			auto dump = std::make_unique<Minidump>(dump_paths[index], false, content, use_index);
+			dump->set_symbols(symbols);
+			Processor processor(block, block, std::move(dump));
+			if (!processor.process(commands))
+				++failures;
+		}
+		catch (const BadCheck& e)
+		{
+			block << "FATAL: " << e.what() << '\n';
+			++failures;
+		}
+		catch (const std::exception& e)
+		{
+			block << "ERROR: " << e.what() << '\n';
+			++failures;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		blocks[index] = block.str();
+		ready[index] = true;
+		for (; next_block < blocks.size() && ready[next_block]; ++next_block)
+		{
+			output << blocks[next_block];
+			std::string().swap(blocks[next_block]);
+		}
+	});
+	output.flush();
+	return failures;
+}
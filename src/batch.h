@@ -0,0 +1,16 @@
+#pragma once
+
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Symbols;
+
+// Replaces directories with the sorted lists of .dmp files in them.
+std::vector<std::string> expand_dump_paths(const std::vector<std::string>& paths);
+
+// Processes the commands for each dump in parallel and writes the output for each dump as a separate block,
+// in the order of the paths. Directories are expanded to the .dmp files in them. Dumps that fail to load
+// are reported in their blocks and skipped. Returns the number of dumps that failed to load or to process.
+size_t process_batch(const std::vector<std::string>& paths, const std::string& commands, const std::shared_ptr<const Symbols>&, bool use_index, std::ostream&);
@@ -0,0 +1,493 @@
+#include "dump_index.h"
+#include "minidump_data.h"
+#include "minidump_format.h"
+#include "utils.h"
+#include <algorithm>
+#include <cstring>
+#include <sys/stat.h>
+
+namespace
+{
+	namespace indexed
+	{
+		// Identifies the dump file the index was made for.
+		struct Key
+		{
+			uint64_t file_size;
+			int64_t  modification_time; // Nanoseconds.
+			uint32_t checksum;
+			uint32_t timestamp;
+			uint64_t flags;
+		};
+
+		struct Header
+		{
+			char     signature[8];
+			Key      key;
+			uint32_t module_count;
+			uint32_t thread_count;
+			uint32_t memory_count;
+			uint32_t memory_range_count;
+			uint32_t memory_region_count;
+			uint32_t unloaded_module_count;
+			uint32_t handle_count;
+			uint32_t flags;
+			uint64_t strings_size;
+			uint64_t timestamp;
+			uint64_t all_images;
+			uint64_t all_stacks;
+			uint32_t max_image;
+			uint32_t max_stack;
+
+			static constexpr char Signature[8] = {'W', 'H', 'Y', 'I', 'D', 'X', '0', '2'};
+
+			enum : uint32_t
+			{
+				Is32Bit = 1 << 0,
+				HasException = 1 << 1,
+			};
+		};
+
+		constexpr char Header::Signature[8];
+
+		struct String
+		{
+			uint64_t offset; // Offset in the string table.
+			uint64_t size;
+		};
+
+		struct Context
+		{
+			uint32_t eip;
+			uint32_t esp;
+			uint32_t ebp;
+			uint32_t _padding;
+			uint64_t rip;
+			uint64_t registers[16];
+		};
+
+		struct Module
+		{
+			String   file_path;
+			String   file_name;
+			String   file_version;
+			String   product_version;
+			String   timestamp;
+			String   pdb_path;
+			String   pdb_name;
+			String   pdb_id;
+			uint64_t image_base;
+			uint64_t image_end;
+		};
+
+		struct Thread
+		{
+			uint32_t id;
+			uint32_t _padding;
+			uint64_t stack_base;
+			uint64_t stack_end;
+			uint64_t stack_offset;
+			uint64_t start_address;
+			Context  context;
+		};
+
+		struct Exception
+		{
+			uint32_t thread_id;
+			uint32_t code;
+			uint32_t operation;
+			uint32_t _padding;
+			uint64_t address;
+			Context  context;
+		};
+
+		struct Memory
+		{
+			uint64_t base;
+			uint64_t end;
+			uint64_t usage_index;
+			uint32_t usage;
+			uint32_t _padding;
+		};
+
+		struct MemoryRange
+		{
+			uint64_t base;
+			uint64_t end;
+			uint64_t offset;
+		};
+
+		struct MemoryRegion
+		{
+			uint64_t base;
+			uint64_t end;
+			uint32_t state;
+			uint32_t _padding;
+		};
+
+		struct UnloadedModule
+		{
+			String   file_path;
+			String   file_name;
+			String   timestamp;
+			uint64_t image_base;
+			uint64_t image_end;
+		};
+
+		struct Handle
+		{
+			uint64_t handle;
+			String   type_name;
+			String   object_name;
+		};
+	}
+
+	bool read_key(const std::string& dump_path, const File& dump_file, indexed::Key& key)
+	{
+		struct ::stat stat;
+		minidump::Header header;
+		if (::stat(dump_path.c_str(), &stat) != 0 || !dump_file.read_at(0, header))
+			return false;
+		::memset(&key, 0, sizeof key);
+		key.file_size = stat.st_size;
+		key.modification_time = int64_t{stat.st_mtim.tv_sec} * 1000000000 + stat.st_mtim.tv_nsec;
+		key.checksum = header.checksum;
+		key.timestamp = header.timestamp;
+		key.flags = header.flags;
+		return true;
+	}
+
+	class Writer
+	{
+	public:
+
+		template <typename T>
+		void write(const T& value)
+		{
+			const auto data = reinterpret_cast<const uint8_t*>(&value);
+			_data.insert(_data.end(), data, data + sizeof value);
+		}
+
+		indexed::String string(const std::string& value)
+		{
+			indexed::String result{_strings.size(), value.size()};
+			_strings += value;
+			return result;
+		}
+
+		indexed::Context context(const MinidumpData::Context& value)
+		{
+			indexed::Context result;
+			::memset(&result, 0, sizeof result);
+			result.eip = value.x86.eip;
+			result.esp = value.x86.esp;
+			result.ebp = value.x86.ebp;
+			result.rip = value.x64.rip;
+			::memcpy(result.registers, value.x64.registers, sizeof result.registers);
+			return result;
+		}
+
+		// Returns the data followed by the string table.
+		std::vector<uint8_t> finish(indexed::Header& header)
+		{
+			header.strings_size = _strings.size();
+			::memcpy(_data.data(), &header, sizeof header);
+			_data.insert(_data.end(), _strings.begin(), _strings.end());
+			return std::move(_data);
+		}
+
+	private:
+		std::vector<uint8_t> _data;
+		std::string _strings;
+	};
+
+	class Reader
+	{
+	public:
+
+		Reader(const File& file, uint64_t offset) : _file(file), _offset(offset) {}
+
+		// Returns nullptr if the data is outside of the file.
+		template <typename T>
+		const T* read(uint64_t count)
+		{
+			const auto result = _file.view<T>(_offset, count);
+			_offset += count * sizeof(T);
+			return result;
+		}
+
+		bool set_strings(uint64_t size)
+		{
+			_strings = read<char>(size);
+			_strings_size = size;
+			return _strings;
+		}
+
+		// Returns false if the string is outside of the string table.
+		bool string(const indexed::String& value, std::string& result) const
+		{
+			if (value.offset > _strings_size || value.size > _strings_size - value.offset)
+				return false;
+			result.assign(_strings + value.offset, value.size);
+			return true;
+		}
+
+	private:
+		const File& _file;
+		uint64_t _offset;
+		const char* _strings = nullptr;
+		uint64_t _strings_size = 0;
+	};
+
+	std::unique_ptr<MinidumpData::Context> to_context(const indexed::Context& value)
+	{
+		auto result = std::make_unique<MinidumpData::Context>();
+		result->x86.eip = value.eip;
+		result->x86.esp = value.esp;
+		result->x86.ebp = value.ebp;
+		result->x64.rip = value.rip;
+		::memcpy(result->x64.registers, value.registers, sizeof result->x64.registers);
+		return result;
+	}
+}
+
+std::unique_ptr<MinidumpData> read_dump_index(const std::string& index_path, const std::string& dump_path)
+{
+	const File index(index_path);
+	if (!index)
+		return nullptr;
+	const auto header = index.view<indexed::Header>(0);
+	if (!header || ::memcmp(header->signature, indexed::Header::Signature, sizeof header->signature) != 0)
+		return nullptr;
+
+	auto dump = std::make_unique<MinidumpData>();
+	dump->file = File(dump_path);
+	indexed::Key key;
+	if (!dump->file || !::read_key(dump_path, dump->file, key) || ::memcmp(&key, &header->key, sizeof key) != 0)
+		return nullptr;
+
+	Reader reader(index, sizeof *header);
+	const auto modules = reader.read<indexed::Module>(header->module_count);
+	const auto threads = reader.read<indexed::Thread>(header->thread_count);
+	const auto exception = reader.read<indexed::Exception>(header->flags & indexed::Header::HasException ? 1 : 0);
+	const auto memory = reader.read<indexed::Memory>(header->memory_count);
+	const auto memory_ranges = reader.read<indexed::MemoryRange>(header->memory_range_count);
+	const auto memory_regions = reader.read<indexed::MemoryRegion>(header->memory_region_count);
+	const auto unloaded_modules = reader.read<indexed::UnloadedModule>(header->unloaded_module_count);
+	const auto handles = reader.read<indexed::Handle>(header->handle_count);
+	if (!modules || !threads || !exception || !memory || !memory_ranges || !memory_regions || !unloaded_modules || !handles
+		|| !reader.set_strings(header->strings_size))
+		return nullptr;
+
+	dump->timestamp = header->timestamp;
+	dump->is_32bit = header->flags & indexed::Header::Is32Bit;
+	dump->memory_usage.all_images = header->all_images;
+	dump->memory_usage.max_image = header->max_image;
+	dump->memory_usage.all_stacks = header->all_stacks;
+	dump->memory_usage.max_stack = header->max_stack;
+
+	dump->modules.resize(header->module_count);
+	for (uint32_t i = 0; i < header->module_count; ++i)
+	{
+		const auto& m = modules[i];
+		auto& module = dump->modules[i];
+		if (!reader.string(m.file_path, module.file_path)
+			|| !reader.string(m.file_name, module.file_name)
+			|| !reader.string(m.file_version, module.file_version)
+			|| !reader.string(m.product_version, module.product_version)
+			|| !reader.string(m.timestamp, module.timestamp)
+			|| !reader.string(m.pdb_path, module.pdb_path)
+			|| !reader.string(m.pdb_name, module.pdb_name)
+			|| !reader.string(m.pdb_id, module.pdb_id))
+			return nullptr;
+		module.image_base = m.image_base;
+		module.image_end = m.image_end;
+	}
+
+	dump->threads.resize(header->thread_count);
+	for (uint32_t i = 0; i < header->thread_count; ++i)
+	{
+		const auto& t = threads[i];
+		auto& thread = dump->threads[i];
+		thread.id = t.id;
+		thread.stack_base = t.stack_base;
+		thread.stack_end = t.stack_end;
+		thread.start_address = t.start_address;
+		thread.context = ::to_context(t.context);
+		thread.stack = MinidumpData::Stack(*dump, t.stack_base, t.stack_end - t.stack_base, t.stack_offset);
+	}
+
+	if (header->flags & indexed::Header::HasException)
+	{
+		// Values that loading the dump would have rejected make the index invalid.
+		if (exception->operation > static_cast<uint32_t>(MinidumpData::Exception::Operation::Executing)
+			|| std::none_of(threads, threads + header->thread_count, [exception](const indexed::Thread& t) { return t.id == exception->thread_id; }))
+			return nullptr;
+		dump->exception = std::make_unique<MinidumpData::Exception>();
+		dump->exception->thread_id = exception->thread_id;
+		dump->exception->code = exception->code;
+		dump->exception->operation = static_cast<MinidumpData::Exception::Operation>(exception->operation);
+		dump->exception->address = exception->address;
+		dump->exception->context = ::to_context(exception->context);
+	}
+
+	for (uint32_t i = 0; i < header->memory_count; ++i)
+	{
+		// Usage indices are one-based.
+		switch (static_cast<MinidumpData::MemoryInfo::Usage>(memory[i].usage))
+		{
+		case MinidumpData::MemoryInfo::Usage::Unknown:
+			break;
+		case MinidumpData::MemoryInfo::Usage::Image:
+			if (!memory[i].usage_index || memory[i].usage_index > header->module_count)
+				return nullptr;
+			break;
+		case MinidumpData::MemoryInfo::Usage::Stack:
+			if (!memory[i].usage_index || memory[i].usage_index > header->thread_count)
+				return nullptr;
+			break;
+		default:
+			return nullptr;
+		}
+		auto& m = dump->memory.emplace_hint(dump->memory.end(), memory[i].base, MinidumpData::MemoryInfo())->second;
+		m.end = memory[i].end;
+		m.usage = static_cast<MinidumpData::MemoryInfo::Usage>(memory[i].usage);
+		m.usage_index = memory[i].usage_index;
+	}
+
+	std::vector<MemoryReader::Range> ranges;
+	ranges.reserve(header->memory_range_count);
+	for (uint32_t i = 0; i < header->memory_range_count; ++i)
+		ranges.push_back({memory_ranges[i].base, memory_ranges[i].end, memory_ranges[i].offset});
+	dump->memory_reader = MemoryReader(dump->file, std::move(ranges));
+
+	for (uint32_t i = 0; i < header->memory_region_count; ++i)
+	{
+		if (memory_regions[i].state > static_cast<uint32_t>(MinidumpData::MemoryRegion::State::Allocated))
+			return nullptr;
+		auto& m = dump->memory_regions.emplace_hint(dump->memory_regions.end(), memory_regions[i].base, MinidumpData::MemoryRegion())->second;
+		m.end = memory_regions[i].end;
+		m.state = static_cast<MinidumpData::MemoryRegion::State>(memory_regions[i].state);
+	}
+
+	dump->unloaded_modules.resize(header->unloaded_module_count);
+	for (uint32_t i = 0; i < header->unloaded_module_count; ++i)
+	{
+		const auto& m = unloaded_modules[i];
+		auto& module = dump->unloaded_modules[i];
+		if (!reader.string(m.file_path, module.file_path)
+			|| !reader.string(m.file_name, module.file_name)
+			|| !reader.string(m.timestamp, module.timestamp))
+			return nullptr;
+		module.image_base = m.image_base;
+		module.image_end = m.image_end;
+	}
+
+	dump->handles.resize(header->handle_count);
+	for (uint32_t i = 0; i < header->handle_count; ++i)
+	{
+		auto& handle = dump->handles[i];
+		handle.handle = handles[i].handle;
+		if (!reader.string(handles[i].type_name, handle.type_name) || !reader.string(handles[i].object_name, handle.object_name))
+			return nullptr;
+	}
+
+	return dump;
+}
+
+bool write_dump_index(const std::string& index_path, const std::string& dump_path, const MinidumpData& dump)
+{
+	indexed::Header header;
+	::memset(&header, 0, sizeof header);
+	::memcpy(header.signature, indexed::Header::Signature, sizeof header.signature);
+	if (!::read_key(dump_path, dump.file, header.key))
+		return false;
+	header.module_count = dump.modules.size();
+	header.thread_count = dump.threads.size();
+	header.memory_count = dump.memory.size();
+	header.memory_range_count = dump.memory_reader.ranges().size();
+	header.memory_region_count = dump.memory_regions.size();
+	header.unloaded_module_count = dump.unloaded_modules.size();
+	header.handle_count = dump.handles.size();
+	header.flags = (dump.is_32bit ? indexed::Header::Is32Bit : 0) | (dump.exception ? indexed::Header::HasException : 0);
+	header.timestamp = dump.timestamp;
+	header.all_images = dump.memory_usage.all_images;
+	header.max_image = dump.memory_usage.max_image;
+	header.all_stacks = dump.memory_usage.all_stacks;
+	header.max_stack = dump.memory_usage.max_stack;
+
+	Writer writer;
+	writer.write(header); // Updated when finished.
+
+	for (const auto& module : dump.modules)
+	{
+		indexed::Module m;
+		m.file_path = writer.string(module.file_path);
+		m.file_name = writer.string(module.file_name);
+		m.file_version = writer.string(module.file_version);
+		m.product_version = writer.string(module.product_version);
+		m.timestamp = writer.string(module.timestamp);
+		m.pdb_path = writer.string(module.pdb_path);
+		m.pdb_name = writer.string(module.pdb_name);
+		m.pdb_id = writer.string(module.pdb_id);
+		m.image_base = module.image_base;
+		m.image_end = module.image_end;
+		writer.write(m);
+	}
+
+	for (const auto& thread : dump.threads)
+	{
+		indexed::Thread t;
+		::memset(&t, 0, sizeof t);
+		t.id = thread.id;
+		t.stack_base = thread.stack_base;
+		t.stack_end = thread.stack_end;
+		t.stack_offset = thread.stack.file_offset();
+		t.start_address = thread.start_address;
+		t.context = writer.context(*thread.context);
+		writer.write(t);
+	}
+
+	if (dump.exception)
+	{
+		indexed::Exception e;
+		::memset(&e, 0, sizeof e);
+		e.thread_id = dump.exception->thread_id;
+		e.code = dump.exception->code;
+		e.operation = static_cast<uint32_t>(dump.exception->operation);
+		e.address = dump.exception->address;
+		e.context = writer.context(*dump.exception->context);
+		writer.write(e);
+	}
+
+	for (const auto& memory : dump.memory)
+		writer.write(indexed::Memory{memory.first, memory.second.end, memory.second.usage_index, static_cast<uint32_t>(memory.second.usage), 0});
+
+	for (const auto& range : dump.memory_reader.ranges())
+		writer.write(indexed::MemoryRange{range.base, range.end, range.offset});
+
+	for (const auto& region : dump.memory_regions)
+		writer.write(indexed::MemoryRegion{region.first, region.second.end, static_cast<uint32_t>(region.second.state), 0});
+
+	for (const auto& module : dump.unloaded_modules)
+	{
+		indexed::UnloadedModule m;
+		m.file_path = writer.string(module.file_path);
+		m.file_name = writer.string(module.file_name);
+		m.timestamp = writer.string(module.timestamp);
+		m.image_base = module.image_base;
+		m.image_end = module.image_end;
+		writer.write(m);
+	}
+
+	for (const auto& handle : dump.handles)
+	{
+		indexed::Handle h;
+		h.handle = handle.handle;
+		h.type_name = writer.string(handle.type_name);
+		h.object_name = writer.string(handle.object_name);
+		writer.write(h);
+	}
+
+	return ::write_file(index_path, writer.finish(header));
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+class MinidumpData;
+
+// Sidecar file with decoded dump data which makes repeated loading of the same dump faster.
+// The index is bound to the size, modification time and header of the dump file.
+
+// Reads the index for the dump, or returns nullptr if it is missing, broken or made for another dump file.
+// Structures derived from the stored data (module index, image tables) are left for the caller to build.
+std::unique_ptr<MinidumpData> read_dump_index(const std::string& index_path, const std::string& dump_path);
+
+// Writes the index for a fully loaded dump.
+bool write_dump_index(const std::string& index_path, const std::string& dump_path, const MinidumpData&);
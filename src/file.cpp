@@ -1,35 +1,71 @@
 #include "file.h"
-#include <limits>
-#include <stdexcept>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+File::File(File&& file)
+	: _data(file._data)
+	, _size(file._size)
+	, _bytes_read(file._bytes_read.load(std::memory_order_relaxed))
+{
+	file._data = nullptr;
+	file._size = 0;
+	file._bytes_read = 0;
+}
 
 File::~File()
 {
-	if (_file)
-		::fclose(_file);
+	if (_data)
+		::munmap(const_cast<uint8_t*>(_data), _size);
 }
 
 File& File::operator=(File&& file)
 {
-	if (_file)
-		::fclose(_file);
-	_file = file._file;
-	file._file = nullptr;
+	if (_data)
+		::munmap(const_cast<uint8_t*>(_data), _size);
+	_data = file._data;
+	_size = file._size;
+	_bytes_read = file._bytes_read.load(std::memory_order_relaxed);
+	file._data = nullptr;
+	file._size = 0;
+	file._bytes_read = 0;
 	return *this;
 }
 
 File::File(const std::string& name)
-	: _file(::fopen(name.c_str(), "rb"))
 {
+	const auto descriptor = ::open(name.c_str(), O_RDONLY);
+	if (descriptor == -1)
+		return;
+	struct ::stat stat;
+	if (::fstat(descriptor, &stat) == 0 && stat.st_size > 0)
+	{
+		// The mapping is read-only, so pages are loaded on first access and never copied.
+		const auto data = ::mmap(nullptr, stat.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+		if (data != MAP_FAILED)
+		{
+			_data = static_cast<const uint8_t*>(data);
+			_size = stat.st_size;
+		}
+	}
+	::close(descriptor);
 }
 
-bool File::read(void* buffer, size_t size)
+bool File::read_at(uint64_t offset, void* buffer, size_t size) const
 {
-	return ::fread(buffer, 1, size, _file) == size;
+	const auto data = view(offset, size);
+	if (!data)
+		return false;
+	::memcpy(buffer, data, size);
+	return true;
 }
 
-bool File::seek(uint64_t offset)
+const void* File::view(uint64_t offset, uint64_t size) const
 {
-	if (offset > std::numeric_limits<long>::max())
-		throw std::logic_error("Large file support is not implemented");
-	return 0 == ::fseek(_file, offset, SEEK_SET);
+	if (offset > _size || size > _size - offset)
+		return nullptr;
+	_bytes_read.fetch_add(size, std::memory_order_relaxed);
+	return _data + offset;
 }
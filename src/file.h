@@ -1,6 +1,7 @@
 #pragma once
 
-#include <cstdio>
+#include <atomic>
+#include <cstdint>
 #include <string>
 
 class File
@@ -9,20 +10,32 @@ public:
 
 	File() = default;
 	File(const File&) = delete;
-	File(File&& file) : _file(file._file) { file._file = nullptr; }
+	File(File&& file);
 	~File();
 	File& operator=(const File&) = delete;
 	File& operator=(File&&);
-	explicit operator bool() const { return _file; }
+	explicit operator bool() const { return _data; }
 
 	File(const std::string& name);
 
-	bool read(void* buffer, size_t size);
-	bool seek(uint64_t offset);
+	// Copies 'size' bytes at 'offset' to the buffer; safe to call concurrently.
+	bool read_at(uint64_t offset, void* buffer, size_t size) const;
+	auto size() const { return _size; }
+
+	// Returns the total size of all successful reads and views, counting repeated accesses again.
+	uint64_t bytes_read() const { return _bytes_read.load(std::memory_order_relaxed); }
+
+	// Returns a read-only view of 'size' bytes at 'offset' or nullptr if the range is outside of the file.
+	const void* view(uint64_t offset, uint64_t size) const;
+
+	template <typename T>
+	bool read_at(uint64_t offset, T& buffer) const { return read_at(offset, &buffer, sizeof buffer); }
 
 	template <typename T>
-	bool read(T& buffer) { return read(&buffer, sizeof buffer); }
+	const T* view(uint64_t offset, uint64_t count = 1) const { return static_cast<const T*>(view(offset, count * sizeof(T))); }
 
 private:
-	FILE* _file = nullptr;
+	const uint8_t* _data = nullptr;
+	uint64_t _size = 0;
+	mutable std::atomic<uint64_t> _bytes_read{0};
 };
@@ -0,0 +1,272 @@
+#include "inventory.h"
+#include "batch.h"
+#include "check.h"
+#include "file.h"
+#include "minidump.h"
+#include "minidump_data.h"
+#include "parallel.h"
+#include "table.h"
+#include "utils.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+
+namespace
+{
+	namespace inventory
+	{
+		// The file consists of the header, the module names sorted by name, the dump paths,
+		// the postings grouped by module names and sorted by dumps, and the string table.
+		struct Header
+		{
+			char     signature[8];
+			uint32_t name_count;
+			uint32_t dump_count;
+			uint64_t posting_count;
+			uint64_t strings_size;
+
+			static constexpr char Signature[8] = {'W', 'H', 'Y', 'I', 'N', 'V', '0', '1'};
+		};
+
+		constexpr char Header::Signature[8];
+
+		// Strings are offsets of null-terminated strings in the string table.
+
+		struct Name
+		{
+			uint32_t name; // Lowercase.
+			uint32_t posting_count;
+			uint64_t first_posting;
+		};
+
+		struct Posting
+		{
+			uint32_t dump;
+			uint32_t version;
+			uint32_t timestamp;
+			uint32_t pdb_id;
+		};
+	}
+
+	std::string to_lower(std::string value)
+	{
+		std::transform(value.begin(), value.end(), value.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+		return value;
+	}
+
+	// Stores each distinct string once.
+	class StringTable
+	{
+	public:
+
+		uint32_t add(const std::string& value)
+		{
+			const auto i = _offsets.emplace(value, _data.size());
+			if (i.second)
+			{
+				CHECK_LE(_data.size() + value.size(), std::numeric_limits<uint32_t>::max(), "Inventory string table is too large");
+				_data.append(value.c_str(), value.size() + 1);
+			}
+			return i.first->second;
+		}
+
+		const std::string& data() const { return _data; }
+
+	private:
+		std::unordered_map<std::string, uint32_t> _offsets;
+		std::string _data;
+	};
+
+	class InventoryReader
+	{
+	public:
+
+		InventoryReader(const std::string& path)
+			: _file(path)
+		{
+			CHECK(_file, "Couldn't open inventory " << path);
+			_header = _file.view<inventory::Header>(0);
+			CHECK(_header && ::memcmp(_header->signature, inventory::Header::Signature, sizeof _header->signature) == 0, "Bad inventory " << path);
+			uint64_t offset = sizeof *_header;
+			_names = next_array<inventory::Name>(offset, _header->name_count);
+			_dumps = next_array<uint32_t>(offset, _header->dump_count);
+			_postings = next_array<inventory::Posting>(offset, _header->posting_count);
+			_strings = next_array<char>(offset, _header->strings_size);
+			CHECK(_names && _dumps && _postings && _strings
+				&& (!_header->strings_size || !_strings[_header->strings_size - 1]), "Bad inventory " << path);
+		}
+
+		const inventory::Name* begin() const { return _names; }
+		const inventory::Name* end() const { return _names + _header->name_count; }
+
+		const inventory::Name* find(const std::string& name) const
+		{
+			const auto i = std::lower_bound(begin(), end(), name, [this](const inventory::Name& a, const std::string& b) { return b.compare(string(a.name)) > 0; });
+			return i != end() && string(i->name) == name ? i : nullptr;
+		}
+
+		std::string dump(uint32_t index) const
+		{
+			CHECK(index < _header->dump_count, "Bad inventory dump index");
+			return string(_dumps[index]);
+		}
+
+		const inventory::Posting* postings(const inventory::Name& name) const
+		{
+			CHECK(name.first_posting <= _header->posting_count && name.posting_count <= _header->posting_count - name.first_posting, "Bad inventory postings");
+			return _postings + name.first_posting;
+		}
+
+		// The string table ends with a null, so any offset inside it is a valid string.
+		const char* string(uint32_t offset) const
+		{
+			CHECK(offset < _header->strings_size, "Bad inventory string");
+			return _strings + offset;
+		}
+
+	private:
+
+		// Returns the array at the offset and moves the offset past it, or nullptr if the array is outside of the file.
+		// The count is checked first, as the array size would overflow for a bad one.
+		template <typename T>
+		const T* next_array(uint64_t& offset, uint64_t count) const
+		{
+			if (offset > _file.size() || count > (_file.size() - offset) / sizeof(T))
+				return nullptr;
+			const auto result = _file.view<T>(offset, count);
+			offset += count * sizeof(T);
+			return result;
+		}
+
+	private:
+		const File _file;
+		const inventory::Header* _header = nullptr;
+		const inventory::Name* _names = nullptr;
+		const uint32_t* _dumps = nullptr;
+		const inventory::Posting* _postings = nullptr;
+		const char* _strings = nullptr;
+	};
+}
+
+size_t build_inventory(const std::string& inventory_path, const std::vector<std::string>& paths, std::ostream& errors)
+{
+	const auto dump_paths = ::expand_dump_paths(paths);
+
+	// Postings are added in the order the dumps finish loading, and get the final dump indices when the inventory is written.
+	std::mutex mutex;
+	StringTable strings;
+	std::unordered_map<std::string, uint32_t> name_indices;
+	std::vector<std::vector<inventory::Posting>> postings;
+	std::vector<bool> loaded(dump_paths.size(), false);
+	::parallel_for(dump_paths.size(), [&](size_t index)
+	{
+		std::unique_ptr<MinidumpData> dump;
+		try
+		{
+			dump = MinidumpData::load(dump_paths[index], false, Minidump::Modules);
+		}
+		catch (const std::exception& e)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			errors << "ERROR: " << dump_paths[index] << ": " << e.what() << std::endl;
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		loaded[index] = true;
+		for (const auto& module : dump->modules)
+		{
+			const auto name = name_indices.emplace(::to_lower(module.file_name), postings.size());
+			if (name.second)
+				postings.emplace_back();
+			postings[name.first->second].push_back({static_cast<uint32_t>(index),
+				strings.add(module.product_version), strings.add(module.timestamp), strings.add(module.pdb_id)});
+		}
+	});
+
+	std::vector<uint32_t> dump_indices(dump_paths.size());
+	std::vector<uint32_t> dumps;
+	for (size_t i = 0; i < dump_paths.size(); ++i)
+	{
+		if (!loaded[i])
+			continue;
+		dump_indices[i] = dumps.size();
+		dumps.emplace_back(strings.add(dump_paths[i]));
+	}
+
+	std::vector<std::pair<std::string, uint32_t>> sorted_names(name_indices.begin(), name_indices.end());
+	std::sort(sorted_names.begin(), sorted_names.end());
+
+	inventory::Header header;
+	::memset(&header, 0, sizeof header);
+	::memcpy(header.signature, inventory::Header::Signature, sizeof header.signature);
+	header.name_count = sorted_names.size();
+	header.dump_count = dumps.size();
+
+	std::vector<inventory::Name> names;
+	names.reserve(sorted_names.size());
+	for (const auto& name : sorted_names)
+	{
+		auto& name_postings = postings[name.second];
+		for (auto& posting : name_postings)
+			posting.dump = dump_indices[posting.dump];
+		std::sort(name_postings.begin(), name_postings.end(), [](const auto& a, const auto& b) { return a.dump < b.dump; });
+		names.push_back({strings.add(name.first), static_cast<uint32_t>(name_postings.size()), header.posting_count});
+		header.posting_count += name_postings.size();
+	}
+	header.strings_size = strings.data().size();
+
+	std::vector<uint8_t> data;
+	const auto append = [&data](const void* value, size_t size)
+	{
+		const auto bytes = static_cast<const uint8_t*>(value);
+		data.insert(data.end(), bytes, bytes + size);
+	};
+	append(&header, sizeof header);
+	append(names.data(), names.size() * sizeof names.front());
+	append(dumps.data(), dumps.size() * sizeof dumps.front());
+	for (const auto& name : sorted_names)
+		append(postings[name.second].data(), postings[name.second].size() * sizeof(inventory::Posting));
+	append(strings.data().data(), strings.data().size());
+	CHECK(::write_file(inventory_path, data), "Couldn't write inventory " << inventory_path);
+
+	return dump_paths.size() - dumps.size();
+}
+
+Table query_inventory(const std::string& inventory_path, const std::string& module_name, const std::string& version)
+{
+	const InventoryReader reader(inventory_path);
+
+	if (module_name.empty())
+	{
+		Table table({{"MODULE"}, {"DUMPS", Table::Format::Decimal}});
+		table.reserve(reader.end() - reader.begin());
+		for (const auto& name : reader)
+		{
+			// A dump may have several modules with the same name loaded.
+			const auto postings = reader.postings(name);
+			size_t dumps = 0;
+			for (uint32_t i = 0; i < name.posting_count; ++i)
+				if (!i || postings[i].dump != postings[i - 1].dump)
+					++dumps;
+			table.push_back({reader.string(name.name), dumps});
+		}
+		return table;
+	}
+
+	Table table({{"DUMP"}, {"VERSION"}, {"TIMESTAMP"}, {"PDB"}});
+	if (const auto name = reader.find(::to_lower(module_name)))
+	{
+		const auto postings = reader.postings(*name);
+		for (uint32_t i = 0; i < name->posting_count; ++i)
+		{
+			const auto& posting = postings[i];
+			if (!version.empty() && version != reader.string(posting.version))
+				continue;
+			table.push_back({reader.dump(posting.dump), reader.string(posting.version), reader.string(posting.timestamp), reader.string(posting.pdb_id)});
+		}
+	}
+	return table;
+}
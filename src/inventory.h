@@ -0,0 +1,18 @@
+#pragma once
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class Table;
+
+// Module inventory of a corpus of dumps, stored as an inverted index from module names to the dumps
+// that have them loaded. Queries read only the index file, so they don't depend on the size of the corpus.
+
+// Reads the module lists of the dumps in parallel and writes the inventory. Directories are expanded
+// to the .dmp files in them. Dumps that fail to load are reported and skipped. Returns the number of such dumps.
+size_t build_inventory(const std::string& inventory_path, const std::vector<std::string>& paths, std::ostream& errors);
+
+// Returns the dumps with the module (of the version, if it isn't empty) loaded,
+// or all modules with the number of dumps having them loaded if the module name is empty.
+Table query_inventory(const std::string& inventory_path, const std::string& module_name, const std::string& version);
@@ -1,6 +1,11 @@
+#include "batch.h"
 #include "check.h"
+#include "inventory.h"
 #include "minidump.h"
 #include "processor.h"
+#include "server.h"
+#include "symbols.h"
+#include "table.h"
 #include <iostream>
 #include <boost/optional/optional.hpp>
 #include <boost/program_options/parsers.hpp>
@@ -9,9 +14,19 @@
 
 struct Options
 {
-	std::string dump;
+	std::vector<std::string> dumps; // Exactly one unless in batch mode.
 	boost::optional<std::string> commands;
+	bool batch = false;
+	bool index = false;
+	boost::optional<std::string> inventory; // Inventory path.
+	bool build_inventory = false;
+	boost::optional<std::string> server; // Socket path.
 	bool summary = false;
+	bool signature = false;
+	unsigned long signature_frames = 5;
+	boost::optional<std::string> symbols;
+	boost::optional<std::string> symbol_cache;
+	uint64_t symbol_cache_size = 1024; // MiB.
 };
 
 int main(int argc, char** argv)
@@ -20,30 +35,178 @@ int main(int argc, char** argv)
 	{
 		boost::program_options::options_description public_options("Options");
 		public_options.add_options()
-			("summary,S", boost::program_options::value<bool>()->zero_tokens());
+			("batch", boost::program_options::value<bool>()->zero_tokens(), "Process the commands for each dump or directory of dumps")
+			("index", boost::program_options::value<bool>()->zero_tokens(), "Cache decoded dump data in DUMP.whyidx files")
+			("inventory", boost::program_options::value<std::string>(), "Query the module inventory of a set of dumps")
+			("build-inventory", boost::program_options::value<std::string>(), "Build the module inventory of the dumps or directories of dumps")
+			("server", boost::program_options::value<std::string>(), "Serve commands over a Unix domain socket")
+			("summary,S", boost::program_options::value<bool>()->zero_tokens())
+			("signature", boost::program_options::value<bool>()->zero_tokens(), "Print the crash signature and exit")
+			("signature-frames", boost::program_options::value<unsigned long>(), "Number of frames in the crash signature (default 5)")
+			("symbols", boost::program_options::value<std::string>(), "Breakpad symbol or symbol store directory")
+			("symbol-cache", boost::program_options::value<std::string>(), "Compiled symbol cache directory")
+			("symbol-cache-size", boost::program_options::value<uint64_t>(), "Symbol cache size limit in MiB (default 1024)");
 
 		boost::program_options::options_description o;
 		o.add(public_options).add_options()
-			("dump", boost::program_options::value<std::string>()->required())
-			("commands", boost::program_options::value<std::string>());
+			("arguments", boost::program_options::value<std::vector<std::string>>());
 
 		boost::program_options::positional_options_description p;
-		p.add("dump", 1).add("commands", 1);
+		p.add("arguments", -1);
 
 		try
 		{
 			boost::program_options::variables_map vm;
 			boost::program_options::store(boost::program_options::command_line_parser(argc, argv).options(o).positional(p).run(), vm);
 			boost::program_options::notify(vm);
-			options.dump = vm["dump"].as<std::string>();
-			if (vm.count("commands"))
-				options.commands = vm["commands"].as<std::string>();
+			if (vm.count("batch"))
+				options.batch = true;
+			if (vm.count("index"))
+				options.index = true;
+			if (vm.count("build-inventory"))
+			{
+				options.inventory = vm["build-inventory"].as<std::string>();
+				options.build_inventory = true;
+			}
+			if (vm.count("inventory"))
+			{
+				if (options.inventory)
+					throw boost::program_options::error("Conflicting inventory options");
+				options.inventory = vm["inventory"].as<std::string>();
+			}
+			if (vm.count("server"))
+				options.server = vm["server"].as<std::string>();
 			if (vm.count("summary"))
 				options.summary = true;
+			if (vm.count("signature"))
+				options.signature = true;
+			if (vm.count("signature-frames"))
+				options.signature_frames = vm["signature-frames"].as<unsigned long>();
+
+			// Arguments are DUMP [COMMANDS], or COMMANDS DUMP... in batch mode, without COMMANDS in signature mode.
+			// Inventory arguments are PATH... when building, or [MODULE [VERSION]] when querying.
+			const auto arguments = vm.count("arguments") ? vm["arguments"].as<std::vector<std::string>>() : std::vector<std::string>();
+			auto argument = arguments.begin();
+			if (options.inventory)
+			{
+				if (options.server || options.batch || options.summary || options.signature
+					|| (options.build_inventory ? arguments.empty() : arguments.size() > 2))
+					throw boost::program_options::error("Bad inventory arguments");
+				options.dumps = arguments;
+			}
+			else if (options.server)
+			{
+				if (!arguments.empty() || options.batch || options.summary || options.signature)
+					throw boost::program_options::error("Bad server arguments");
+			}
+			else if (options.batch)
+			{
+				if (!options.signature && argument != arguments.end())
+					options.commands = *argument++;
+				options.dumps.assign(argument, arguments.end());
+				if (options.dumps.empty() || options.summary)
+					throw boost::program_options::error("Bad batch arguments");
+			}
+			else
+			{
+				if (argument == arguments.end())
+					throw boost::program_options::error("No dump specified");
+				options.dumps.emplace_back(*argument++);
+				if (argument != arguments.end())
+					options.commands = *argument++;
+				if (argument != arguments.end())
+					throw boost::program_options::error("Too many arguments");
+			}
+
+			// Signature mode is a one-shot command that loads only the streams it needs.
+			if (options.signature)
+			{
+				if (options.commands || options.summary)
+					throw boost::program_options::error("--signature can't be combined with commands");
+				options.commands = "sig " + std::to_string(options.signature_frames);
+			}
+			if (vm.count("symbols"))
+				options.symbols = vm["symbols"].as<std::string>();
+			if (vm.count("symbol-cache"))
+				options.symbol_cache = vm["symbol-cache"].as<std::string>();
+			if (vm.count("symbol-cache-size"))
+				options.symbol_cache_size = vm["symbol-cache-size"].as<uint64_t>();
 		}
 		catch (const boost::program_options::error&)
 		{
-			std::cerr << "Usage:\n  whydebug [OPTIONS] DUMP [COMMAND]\n\n" << public_options << std::endl;
+			std::cerr << "Usage:\n  whydebug [OPTIONS] DUMP [COMMAND]\n  whydebug [OPTIONS] --batch COMMAND PATH...\n  whydebug [OPTIONS] --server SOCKET\n"
+				"  whydebug --build-inventory INVENTORY PATH...\n  whydebug --inventory INVENTORY [MODULE [VERSION]]\n\n" << public_options << std::endl;
+			return 1;
+		}
+	}
+
+	// Inventories don't involve commands or symbols.
+	if (options.inventory)
+	{
+		try
+		{
+			if (options.build_inventory)
+				return ::build_inventory(*options.inventory, options.dumps, std::cerr) ? 1 : 0;
+			options.dumps.resize(2);
+			const auto table = ::query_inventory(*options.inventory, options.dumps[0], options.dumps[1]);
+			table.print(std::cout);
+			return 0;
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "ERROR: " << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	std::shared_ptr<const Symbols> symbols;
+	if (!options.summary && (options.symbols || options.symbol_cache))
+	{
+		auto cache = options.symbol_cache
+			? std::make_unique<SymbolCache>(*options.symbol_cache, options.symbol_cache_size << 20)
+			: nullptr;
+		symbols = std::make_shared<Symbols>(options.symbols.value_or(std::string()), std::move(cache));
+	}
+
+	if (options.server)
+	{
+		try
+		{
+			::run_server(*options.server, symbols, options.index);
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "ERROR: " << e.what() << std::endl;
+		}
+		return 1;
+	}
+
+	if (options.batch)
+	{
+		try
+		{
+			return ::process_batch(options.dumps, *options.commands, symbols, options.index, std::cout) ? 1 : 0;
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "ERROR: " << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	Processor processor(std::cout, std::cerr);
+
+	// One-shot invocations load only what the commands need.
+	auto content = Minidump::All;
+	if (options.commands && !options.summary)
+	{
+		try
+		{
+			content = static_cast<Minidump::Content>(processor.content(*options.commands));
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "ERROR: " << e.what() << std::endl;
 			return 1;
 		}
 	}
@@ -51,7 +214,7 @@ int main(int argc, char** argv)
 	std::unique_ptr<Minidump> dump;
 	try
 	{
-		dump = std::make_unique<Minidump>(options.dump, options.summary);
+		dump = std::make_unique<Minidump>(options.dumps.front(), options.summary, content, options.index);
 	}
 	catch (const BadCheck& e)
 	{
@@ -61,7 +224,8 @@ int main(int argc, char** argv)
 
 	if (!options.summary)
 	{
-		Processor processor(std::move(dump));
+		dump->set_symbols(symbols);
+		processor.set_dump(std::move(dump));
 		if (options.commands)
 			return processor.process(*options.commands) ? 0 : 1;
 		for (std::string line; ; )
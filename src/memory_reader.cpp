@@ -0,0 +1,51 @@
+#include "memory_reader.h"
+#include "file.h"
+#include <algorithm>
+#include <cstring>
+
+MemoryReader::MemoryReader(const File& file, std::vector<Range>&& ranges)
+	: _file(&file)
+	, _ranges(std::move(ranges))
+{
+	std::sort(_ranges.begin(), _ranges.end(), [](const Range& a, const Range& b) { return a.base < b.base; });
+}
+
+bool MemoryReader::read(uint64_t address, void* buffer, size_t size) const
+{
+	auto range = find(address);
+	if (!range)
+		return false;
+	for (auto output = static_cast<uint8_t*>(buffer); ; )
+	{
+		const auto part_size = std::min<uint64_t>(size, range->end - address);
+		const auto data = _file->view(range->offset + (address - range->base), part_size);
+		if (!data)
+			return false;
+		::memcpy(output, data, part_size);
+		size -= part_size;
+		if (!size)
+			return true;
+		output += part_size;
+		address += part_size;
+		++range;
+		if (range == _ranges.data() + _ranges.size() || range->base != address)
+			return false;
+	}
+}
+
+const void* MemoryReader::view(uint64_t address, uint64_t size) const
+{
+	const auto range = find(address);
+	if (!range || size > range->end - address)
+		return nullptr;
+	return _file->view(range->offset + (address - range->base), size);
+}
+
+const MemoryReader::Range* MemoryReader::find(uint64_t address) const
+{
+	auto i = std::upper_bound(_ranges.begin(), _ranges.end(), address, [](uint64_t address, const Range& range) { return address < range.base; });
+	if (i == _ranges.begin())
+		return nullptr;
+	--i;
+	return address < i->end ? &*i : nullptr;
+}
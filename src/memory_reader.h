@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class File;
+
+// Random access to process memory captured in the dump.
+class MemoryReader
+{
+public:
+
+	// Captured memory range.
+	struct Range
+	{
+		uint64_t base = 0;   // Virtual address of the range.
+		uint64_t end = 0;    // Virtual address of the range end.
+		uint64_t offset = 0; // Offset of the range data in the dump file.
+	};
+
+	MemoryReader() = default;
+	MemoryReader(const File&, std::vector<Range>&&);
+
+	// Copies memory at the specified address to the buffer, the memory may span adjacent ranges.
+	bool read(uint64_t address, void* buffer, size_t size) const;
+
+	// Returns the sorted list of captured memory ranges.
+	const std::vector<Range>& ranges() const { return _ranges; }
+
+	// Returns a view of captured memory at the specified address
+	// or nullptr if the memory isn't captured within a single range.
+	const void* view(uint64_t address, uint64_t size) const;
+
+	template <typename T>
+	bool read(uint64_t address, T& value) const { return read(address, &value, sizeof value); }
+
+	template <typename T>
+	const T* view(uint64_t address, uint64_t count = 1) const { return static_cast<const T*>(view(address, count * sizeof(T))); }
+
+private:
+
+	// Returns the range containing the address or nullptr if the address isn't captured.
+	const Range* find(uint64_t address) const;
+
+private:
+	const File* _file = nullptr;
+	std::vector<Range> _ranges;
+};
@@ -1,74 +1,337 @@
 #include "minidump.h"
 #include "minidump_data.h"
+#include "parallel.h"
+#include "scan.h"
+#include "symbols.h"
 #include "table.h"
+#include "unwind.h"
 #include "utils.h"
 #include <algorithm>
+#include <cctype>
+#include <functional>
 #include <iostream>
+#include <unordered_map>
 
 namespace
 {
-	std::string decode_code_address(const MinidumpData& dump, uint64_t address)
+	std::string usage_to_string(const MinidumpData& dump, const MinidumpData::MemoryInfo& memory_info)
 	{
-		const auto i = std::find_if(dump.modules.begin(), dump.modules.end(), [address](const auto& module)
+		switch (memory_info.usage)
+		{
+		case MinidumpData::MemoryInfo::Usage::Image:
+			return dump.modules[memory_info.usage_index - 1].file_name;
+		case MinidumpData::MemoryInfo::Usage::Stack:
+			return "< stack " + std::to_string(memory_info.usage_index) + " >";
+		default:
+			return {};
+		}
+	}
+
+	// Returns the usage of the captured memory range containing the address.
+	std::string usage_to_string(const MinidumpData& dump, uint64_t address)
+	{
+		auto i = dump.memory.upper_bound(address);
+		if (i == dump.memory.begin())
+			return {};
+		--i;
+		return address < i->second.end ? ::usage_to_string(dump, i->second) : std::string();
+	}
+
+	// Table formatters keep the dump data alive, so tables may outlive the Minidump they were made from.
+	Table::Formatter usage_formatter(const std::shared_ptr<const MinidumpData>& dump)
+	{
+		return [dump](uint64_t address) { return ::usage_to_string(*dump, address); };
+	}
+
+	// Scans all captured memory in parallel and returns sorted addresses found by the scanning function.
+	// Memory ranges are split into chunks to balance the work between threads, and each chunk
+	// also covers 'overlap' bytes of the next one to find matches crossing chunk boundaries.
+	std::vector<uint64_t> scan_memory(const MinidumpData& dump, size_t overlap,
+		const std::function<void(uint64_t address, const uint8_t* data, size_t size, size_t limit, std::vector<size_t>& offsets)>& scan)
+	{
+		static const uint64_t chunk_size = 1 << 20;
+
+		std::vector<std::pair<const MemoryReader::Range*, uint64_t>> chunks;
+		for (const auto& range : dump.memory_reader.ranges())
+			for (uint64_t offset = 0; offset < range.end - range.base; offset += chunk_size)
+				chunks.emplace_back(&range, offset);
+
+		std::vector<std::vector<size_t>> offsets(chunks.size());
+		::parallel_for(chunks.size(), [&dump, overlap, &scan, &chunks, &offsets](size_t index)
 		{
-			return address >= module.image_base && address < module.image_end;
+			const auto address = chunks[index].first->base + chunks[index].second;
+			const auto size = std::min(chunks[index].first->end - address, chunk_size + overlap);
+			const auto data = dump.memory_reader.view<uint8_t>(address, size);
+			if (data)
+				scan(address, data, size, chunk_size, offsets[index]);
 		});
-		return i != dump.modules.end()
-			? i->file_name + "!" + ::to_hex(address, dump.is_32bit)
-			: ::to_hex(address, dump.is_32bit);
+
+		std::vector<uint64_t> addresses;
+		for (size_t i = 0; i < chunks.size(); ++i)
+			for (const auto offset : offsets[i])
+				addresses.emplace_back(chunks[i].first->base + chunks[i].second + offset);
+		return addresses;
 	}
 
-	std::vector<std::pair<uint32_t, uint32_t>> build_call_chain(const MinidumpData::Thread& thread, const MinidumpData::Exception* exception)
+	std::string decode_code_address(const MinidumpData& dump, const Symbols* symbols, uint64_t address, size_t module_index)
 	{
-		std::vector<std::pair<uint32_t, uint32_t>> chain;
-		auto ebp = exception ? exception->context->x86.ebp : thread.context->x86.ebp;
-		chain.emplace_back(ebp, exception ? exception->context->x86.eip : thread.context->x86.eip);
-		while (ebp >= thread.stack_base && ebp + 8 < thread.stack_end)
+		const auto module_name = dump.module_name_by_index(module_index);
+		if (module_name.empty())
+			return ::to_hex(address, dump.is_32bit);
+		if (module_index < dump.modules.size())
+		{
+			// Symbol files have private functions and line information, exports are the fallback.
+			const auto& module = dump.modules[module_index];
+			const auto rva = static_cast<uint32_t>(address - module.image_base);
+			const auto symbol_table = symbols ? symbols->find(module.pdb_name, module.pdb_id) : nullptr;
+			const auto export_table = dump.images.exports(module_index);
+			Symbol symbol;
+			if ((symbol_table && symbol_table->find(rva, symbol)) || (export_table && export_table->find(rva, symbol)))
+			{
+				auto result = module_name + "!" + symbol.name;
+				if (symbol.offset)
+					result += "+0x" + ::to_hex_min(symbol.offset);
+				if (symbol.line)
+					result += " [" + symbol.file.substr(symbol.file.find_last_of("/\\") + 1) + " @ " + std::to_string(symbol.line) + "]";
+				return result;
+			}
+		}
+		return module_name + "!" + ::to_hex(address, dump.is_32bit);
+	}
+
+	std::string decode_code_address(const MinidumpData& dump, const Symbols* symbols, uint64_t address)
+	{
+		return decode_code_address(dump, symbols, address, dump.module_index.find(address));
+	}
+
+	Table::Formatter code_address_formatter(const std::shared_ptr<const MinidumpData>& dump, const std::shared_ptr<const Symbols>& symbols)
+	{
+		return [dump, symbols](uint64_t address) { return ::decode_code_address(*dump, symbols.get(), address); };
+	}
+
+	// Resolves modules for all return addresses of a call chain at once.
+	std::vector<size_t> resolve_call_chain(const MinidumpData& dump, const std::vector<std::pair<uint64_t, uint64_t>>& chain)
+	{
+		std::vector<uint64_t> addresses;
+		addresses.reserve(chain.size());
+		for (const auto& entry : chain)
+			addresses.emplace_back(entry.second);
+		std::vector<size_t> module_indices(addresses.size());
+		dump.module_index.find(addresses.data(), addresses.size(), module_indices.data());
+		return module_indices;
+	}
+
+	uint64_t instruction_pointer(const MinidumpData& dump, const MinidumpData::Context& context)
+	{
+		return dump.is_32bit ? context.x86.eip : context.x64.rip;
+	}
+
+	// Returns frame (EBP or RSP) and instruction pointers of the call stack.
+	// If the walk breaks before reaching the outermost frame, 'scan_start' is set to the stack address to continue scanning from.
+	std::vector<std::pair<uint64_t, uint64_t>> build_call_chain(const MinidumpData& dump, const MinidumpData::Thread& thread,
+		const MinidumpData::Exception* exception, uint64_t& scan_start)
+	{
+		const auto& context = exception ? *exception->context : *thread.context;
+		scan_start = 0;
+		if (!dump.is_32bit)
+		{
+			bool complete = false;
+			auto chain = ::unwind_x64(dump, thread, context, complete);
+			if (!complete)
+				scan_start = chain.back().first;
+			return chain;
+		}
+		std::vector<std::pair<uint64_t, uint64_t>> chain;
+		auto ebp = context.x86.ebp;
+		chain.emplace_back(ebp, context.x86.eip);
+		const auto stack = thread.stack.data();
+		if (!stack)
+			return chain;
+		auto last_read = uint64_t{context.x86.esp};
+		while (ebp >= thread.stack_base && ebp + 8 < thread.stack_end && chain.size() < MaxFrames)
 		{
 			const auto stack_offset = ebp - thread.stack_base;
-			const auto return_address = reinterpret_cast<uint32_t&>(thread.stack[stack_offset + 4]);
-			ebp = reinterpret_cast<uint32_t&>(thread.stack[stack_offset]);
+			const auto next_ebp = reinterpret_cast<const uint32_t&>(stack[stack_offset]);
+			// Callers' frames are higher on the stack, so a frame pointer that doesn't grow is corrupted
+			// and the frame is left to scanning.
+			if (next_ebp && next_ebp <= ebp)
+				break;
+			const auto return_address = reinterpret_cast<const uint32_t&>(stack[stack_offset + 4]);
+			last_read = ebp + 8;
+			ebp = next_ebp;
 			chain.emplace_back(ebp, return_address);
 		}
+		if (ebp) // Frame pointer omission or corruption breaks the chain before the outermost frame.
+			scan_start = last_read;
 		return chain;
 	}
 
-	Table print_call_stack(const MinidumpData& dump, const MinidumpData::Thread& thread, const MinidumpData::Exception* exception)
+	bool has_call_stack(const MinidumpData& dump, const MinidumpData::Thread& thread)
 	{
-		if (!thread.start_address || !thread.context->x86.eip || !thread.context->x86.ebp)
-			return {};
-		if (exception && exception->thread_id == thread.id)
+		return thread.start_address && ::instruction_pointer(dump, *thread.context) && (!dump.is_32bit || thread.context->x86.ebp);
+	}
+
+	// Returns the call chain continued by stack scanning if the walk breaks.
+	// Frames found by scanning have stack addresses instead of frame pointers and follow the first 'walked_frames' frames.
+	std::vector<std::pair<uint64_t, uint64_t>> walk_call_stack(const MinidumpData& dump, const MinidumpData::Thread& thread,
+		const MinidumpData::Exception* exception, size_t& walked_frames)
+	{
+		uint64_t scan_start = 0;
+		auto chain = build_call_chain(dump, thread, exception, scan_start);
+		walked_frames = chain.size();
+		if (scan_start)
+		{
+			const auto scanned = ::scan_stack(dump, thread, scan_start, true);
+			chain.insert(chain.end(), scanned.begin(), scanned.end());
+		}
+		return chain;
+	}
+
+	const MinidumpData::Exception* thread_exception(const MinidumpData& dump, const MinidumpData::Thread& thread)
+	{
+		return dump.exception && dump.exception->thread_id == thread.id ? dump.exception.get() : nullptr;
+	}
+
+	// Formats sorted one-based indices, collapsing consecutive ones into ranges.
+	std::string indices_to_string(const std::vector<size_t>& indices)
+	{
+		std::string result;
+		for (size_t i = 0; i < indices.size(); )
 		{
-			Table table({{"EBP"}, {"RETURN"}, {"FUNCTION"}, {"EXCEPTION"}});
-			for (const auto& entry : build_call_chain(thread, exception))
+			auto j = i + 1;
+			while (j < indices.size() && indices[j] == indices[j - 1] + 1)
+				++j;
+			if (!result.empty())
+				result += ", ";
+			result += std::to_string(indices[i] + 1);
+			if (j - i > 1)
+				result += "-" + std::to_string(indices[j - 1] + 1);
+			i = j;
+		}
+		return result;
+	}
+
+	struct DiffEntry
+	{
+		std::string key;
+		std::string name;
+		std::string description;
+	};
+
+	// Counts the names, keeping the order of their first occurrences.
+	std::vector<DiffEntry> count_names(const std::vector<std::string>& names)
+	{
+		std::vector<DiffEntry> entries;
+		std::vector<size_t> counts;
+		std::unordered_map<std::string, size_t> indices;
+		indices.reserve(names.size());
+		for (const auto& name : names)
+		{
+			const auto i = indices.emplace(name, entries.size());
+			if (i.second)
 			{
-				table.push_back({
-					::to_hex(entry.first, dump.is_32bit),
-					::to_hex(entry.second, dump.is_32bit),
-					decode_code_address(dump, entry.second),
-					table.rows() == 0 ? exception->to_string(dump.is_32bit) : "",
-				});
+				entries.push_back({name, name, {}});
+				counts.emplace_back(0);
 			}
-			return table;
+			++counts[i.first->second];
 		}
-		else
+		for (size_t i = 0; i < entries.size(); ++i)
+			entries[i].description = std::to_string(counts[i]);
+		return entries;
+	}
+
+	// Modules are matched by file name and timestamp, so a rebuilt module is removed and added.
+	std::vector<DiffEntry> module_diff_entries(const MinidumpData& dump, const Symbols*)
+	{
+		std::vector<DiffEntry> entries;
+		entries.reserve(dump.modules.size());
+		for (const auto& module : dump.modules)
+			entries.push_back({module.file_name + '\n' + module.timestamp, module.file_name, module.product_version + " @ " + ::to_hex(module.image_base, dump.is_32bit)});
+		return entries;
+	}
+
+	// Threads are counted by start function, which doesn't depend on module load addresses.
+	std::vector<DiffEntry> thread_diff_entries(const MinidumpData& dump, const Symbols* symbols)
+	{
+		std::vector<uint64_t> addresses;
+		addresses.reserve(dump.threads.size());
+		for (const auto& thread : dump.threads)
+			addresses.emplace_back(thread.start_address);
+		std::vector<size_t> module_indices(addresses.size());
+		dump.module_index.find(addresses.data(), addresses.size(), module_indices.data());
+		std::vector<std::string> names;
+		names.reserve(addresses.size());
+		for (size_t i = 0; i < addresses.size(); ++i)
+			names.emplace_back(::decode_code_address(dump, symbols, addresses[i], module_indices[i]));
+		return ::count_names(names);
+	}
+
+	std::vector<DiffEntry> handle_diff_entries(const MinidumpData& dump, const Symbols*)
+	{
+		std::vector<std::string> names;
+		names.reserve(dump.handles.size());
+		for (const auto& handle : dump.handles)
+			names.emplace_back(handle.type_name);
+		return ::count_names(names);
+	}
+
+	// Hash-joins the entries by key and adds rows for removed, changed and added entries.
+	void diff(Table& table, const std::string& kind, const std::vector<DiffEntry>& old_entries, const std::vector<DiffEntry>& new_entries)
+	{
+		std::unordered_multimap<std::string, size_t> new_indices;
+		new_indices.reserve(new_entries.size());
+		for (size_t i = 0; i < new_entries.size(); ++i)
+			new_indices.emplace(new_entries[i].key, i);
+		std::vector<bool> matched(new_entries.size(), false);
+		for (const auto& old_entry : old_entries)
 		{
-			Table table({{"EBP"}, {"RETURN"}, {"FUNCTION"}});
-			for (const auto& entry : build_call_chain(thread, nullptr))
+			const auto range = new_indices.equal_range(old_entry.key);
+			const auto i = std::find_if(range.first, range.second, [&matched](const auto& entry) { return !matched[entry.second]; });
+			if (i == range.second)
 			{
-				table.push_back({
-					::to_hex(entry.first, dump.is_32bit),
-					::to_hex(entry.second, dump.is_32bit),
-					decode_code_address(dump, entry.second),
-				});
+				table.push_back({kind, "removed", old_entry.name, old_entry.description, ""});
+				continue;
 			}
-			return table;
+			const auto& new_entry = new_entries[i->second];
+			matched[i->second] = true;
+			if (new_entry.description != old_entry.description)
+				table.push_back({kind, "changed", old_entry.name, old_entry.description, new_entry.description});
 		}
+		for (size_t i = 0; i < new_entries.size(); ++i)
+			if (!matched[i])
+				table.push_back({kind, "added", new_entries[i].name, "", new_entries[i].description});
+	}
+
+	Table print_call_stack(const MinidumpData& dump, const Symbols* symbols, const MinidumpData::Thread& thread, const MinidumpData::Exception* exception)
+	{
+		if (!has_call_stack(dump, thread))
+			return {};
+		if (exception && exception->thread_id != thread.id)
+			exception = nullptr;
+
+		std::vector<Table::ColumnHeader> columns{{dump.is_32bit ? "EBP" : "RSP", Table::address(dump.is_32bit)}, {"RETURN", Table::address(dump.is_32bit)}, {"FUNCTION"}};
+		if (exception)
+			columns.emplace_back("EXCEPTION");
+		Table table(std::move(columns));
+
+		// Scanned frames may be stale, so they are marked.
+		size_t walked_frames = 0;
+		const auto chain = walk_call_stack(dump, thread, exception, walked_frames);
+		const auto module_indices = resolve_call_chain(dump, chain);
+		for (size_t i = 0; i < chain.size(); ++i)
+		{
+			const auto function = (i < walked_frames ? "" : "? ") + decode_code_address(dump, symbols, chain[i].second, module_indices[i]);
+			if (exception)
+				table.push_back({chain[i].first, chain[i].second, function, i == 0 ? exception->to_string(dump.is_32bit) : ""});
+			else
+				table.push_back({chain[i].first, chain[i].second, function});
+		}
+		return table;
 	}
 }
 
-Minidump::Minidump(const std::string& file_name, bool summary)
-	: _data(MinidumpData::load(file_name, summary))
+Minidump::Minidump(const std::string& file_name, bool summary, unsigned content, bool use_index)
+	: _data(MinidumpData::load(file_name, summary, content, use_index))
 {
 }
 
@@ -76,22 +339,96 @@ Minidump::~Minidump()
 {
 }
 
+void Minidump::set_symbols(const std::shared_ptr<const Symbols>& symbols)
+{
+	_symbols = symbols;
+}
+
+Table Minidump::print_all_call_stacks() const
+{
+	struct Frame
+	{
+		uint64_t address;
+		std::string function;
+	};
+
+	// Threads are walked and decoded in parallel, then their frames are concatenated in thread order.
+	std::vector<std::vector<Frame>> thread_frames(_data->threads.size());
+	::parallel_for(_data->threads.size(), [this, &thread_frames](size_t index)
+	{
+		const auto& thread = _data->threads[index];
+		if (!::has_call_stack(*_data, thread))
+			return;
+		size_t walked_frames = 0;
+		const auto chain = ::walk_call_stack(*_data, thread, ::thread_exception(*_data, thread), walked_frames);
+		const auto module_indices = ::resolve_call_chain(*_data, chain);
+		auto& frames = thread_frames[index];
+		frames.reserve(chain.size());
+		for (size_t i = 0; i < chain.size(); ++i)
+			frames.push_back({chain[i].second, (i < walked_frames ? "" : "? ") + decode_code_address(*_data, _symbols.get(), chain[i].second, module_indices[i])});
+	});
+
+	Table table({{"THREAD", Table::Format::Decimal}, {"FRAME", Table::Format::Decimal}, {"RETURN", Table::address(_data->is_32bit)}, {"FUNCTION"}});
+	size_t total_rows = 0;
+	for (const auto& frames : thread_frames)
+		total_rows += frames.size();
+	table.reserve(total_rows);
+	for (size_t i = 0; i < thread_frames.size(); ++i)
+		for (size_t j = 0; j < thread_frames[i].size(); ++j)
+			table.push_back({i + 1, j, thread_frames[i][j].address, thread_frames[i][j].function});
+	return table;
+}
+
+Table Minidump::print_diff(const std::string& file_name) const
+{
+	using Entries = std::vector<DiffEntry> (*)(const MinidumpData&, const Symbols*);
+	static const std::pair<const char*, Entries> kinds[] =
+	{
+		{ "module", ::module_diff_entries },
+		{ "thread", ::thread_diff_entries },
+		{ "handle", ::handle_diff_entries },
+	};
+	constexpr auto kind_count = sizeof kinds / sizeof *kinds;
+
+	// The other dump is loaded while the entries of this one are collected.
+	std::unique_ptr<Minidump> other;
+	std::vector<DiffEntry> old_entries[kind_count];
+	std::vector<DiffEntry> new_entries[kind_count];
+	TaskGraph tasks;
+	const auto load_task = tasks.add([this, &file_name, &other]
+	{
+		other = std::make_unique<Minidump>(file_name, false, Modules | Threads | Memory | Handles | UnloadedModules);
+		other->set_symbols(_symbols);
+	});
+	for (size_t i = 0; i < kind_count; ++i)
+	{
+		tasks.add([this, i, &old_entries] { old_entries[i] = kinds[i].second(*_data, _symbols.get()); });
+		tasks.depend(tasks.add([i, &other, &new_entries] { new_entries[i] = kinds[i].second(*other->_data, other->_symbols.get()); }), load_task);
+	}
+	tasks.run();
+
+	Table table({{"KIND", Table::Format::Enum}, {"CHANGE", Table::Format::Enum}, {"NAME"}, {"OLD"}, {"NEW"}});
+	for (size_t i = 0; i < kind_count; ++i)
+		::diff(table, kinds[i].first, old_entries[i], new_entries[i]);
+	return table;
+}
+
 Table Minidump::print_exception_call_stack() const
 {
 	if (!_data->exception)
 		return {};
-	return ::print_call_stack(*_data, *_data->exception->thread, _data->exception.get());
+	return ::print_call_stack(*_data, _symbols.get(), *_data->exception->thread, _data->exception.get());
 }
 
 Table Minidump::print_handles() const
 {
-	Table table({{"#", Table::Alignment::Right}, {"HANDLE", Table::Alignment::Right}, {"TYPE"}, {"OBJECT"}});
+	Table table({{"#", Table::Format::Decimal}, {"HANDLE", Table::Format::Hex}, {"TYPE", Table::Format::Enum}, {"OBJECT"}});
 	table.reserve(_data->handles.size());
 	for (const auto& handle : _data->handles)
 	{
 		table.push_back({
-			std::to_string(&handle - &_data->handles.front() + 1),
-			::to_hex_min(handle.handle),
+			static_cast<uint64_t>(&handle - &_data->handles.front() + 1),
+			handle.handle,
 			handle.type_name,
 			handle.object_name,
 		});
@@ -101,33 +438,38 @@ Table Minidump::print_handles() const
 
 Table Minidump::print_memory() const
 {
-	const auto usage_to_string = [this](const MinidumpData::MemoryInfo& memory_info) -> std::string
-	{
-		switch (memory_info.usage)
-		{
-		case MinidumpData::MemoryInfo::Usage::Image:
-			return _data->modules[memory_info.usage_index - 1].file_name;
-		case MinidumpData::MemoryInfo::Usage::Stack:
-			return "< stack " + std::to_string(memory_info.usage_index) + " >";
-		default:
-			return {};
-		}
-	};
-
-	Table table({{"BASE"}, {"END"}, {"SIZE", Table::Alignment::Right}, {"USAGE"}});
+	Table table({{"BASE", Table::address(_data->is_32bit)}, {"END", Table::address(_data->is_32bit)}, {"SIZE", Table::Format::Hex}, {"USAGE", ::usage_formatter(_data)}});
 	table.reserve(_data->memory.size());
 	for (const auto& memory_range : _data->memory)
 	{
 		table.push_back({
-			::to_hex(memory_range.first, _data->is_32bit),
-			::to_hex(memory_range.second.end, _data->is_32bit),
-			::to_hex_min(memory_range.second.end - memory_range.first),
-			usage_to_string(memory_range.second),
+			memory_range.first,
+			memory_range.second.end,
+			memory_range.second.end - memory_range.first,
+			memory_range.first,
 		});
 	}
 	return table;
 }
 
+void Minidump::print_memory_data(std::ostream& stream, uint64_t address, uint64_t size) const
+{
+	size &= _data->is_32bit ? ~uint64_t{3} : ~uint64_t{7};
+	auto data = _data->memory_reader.view(address, size);
+	std::vector<uint8_t> buffer;
+	if (!data)
+	{
+		buffer.resize(size);
+		if (!_data->memory_reader.read(address, buffer.data(), size))
+			throw std::runtime_error("Memory at " + ::to_hex(address, _data->is_32bit) + " is not present in the dump");
+		data = buffer.data();
+	}
+	if (_data->is_32bit)
+		::print_data(stream, static_cast<uint32_t>(address), static_cast<const uint32_t*>(data), size);
+	else
+		::print_data(stream, address, static_cast<const uint64_t*>(data), size);
+}
+
 Table Minidump::print_memory_regions() const
 {
 	const auto state_to_string = [this](MinidumpData::MemoryRegion::State state) -> std::string
@@ -145,14 +487,14 @@ Table Minidump::print_memory_regions() const
 		}
 	};
 
-	Table table({{"BASE"}, {"END"}, {"SIZE", Table::Alignment::Right}, {"STATE"}});
+	Table table({{"BASE", Table::address(_data->is_32bit)}, {"END", Table::address(_data->is_32bit)}, {"SIZE", Table::Format::Hex}, {"STATE", Table::Format::Enum}});
 	table.reserve(_data->memory_regions.size());
 	for (const auto& memory_region : _data->memory_regions)
 	{
 		table.push_back({
-			::to_hex(memory_region.first, _data->is_32bit),
-			::to_hex(memory_region.second.end, _data->is_32bit),
-			::to_hex_min(memory_region.second.end - memory_region.first),
+			memory_region.first,
+			memory_region.second.end,
+			memory_region.second.end - memory_region.first,
 			state_to_string(memory_region.second.state),
 		});
 	}
@@ -161,51 +503,226 @@ Table Minidump::print_memory_regions() const
 
 Table Minidump::print_modules() const
 {
-	Table table({{"#", Table::Alignment::Right}, {"NAME"}, {"VERSION"}, {"IMAGE"}, {"END"}, {"SIZE", Table::Alignment::Right}, {"PDB"}});
+	Table table({{"#", Table::Format::Decimal}, {"NAME"}, {"VERSION"}, {"IMAGE", Table::address(_data->is_32bit)}, {"END", Table::address(_data->is_32bit)}, {"SIZE", Table::Format::Hex}, {"PDB"}});
 	table.reserve(_data->modules.size());
 	for (const auto& module : _data->modules)
 	{
 		table.push_back({
-			std::to_string(&module - &_data->modules.front() + 1),
+			static_cast<uint64_t>(&module - &_data->modules.front() + 1),
 			module.file_name,
 			module.product_version,
-			::to_hex(module.image_base, _data->is_32bit),
-			::to_hex(module.image_end, _data->is_32bit),
-			::to_hex_min(module.image_end - module.image_base),
+			module.image_base,
+			module.image_end,
+			module.image_end - module.image_base,
 			module.pdb_name,
 		});
 	}
 	return table;
 }
 
+Table Minidump::print_pattern_matches(const std::string& pattern) const
+{
+	const auto addresses = ::scan_memory(*_data, pattern.size() - 1,
+		[&pattern](uint64_t, const uint8_t* data, size_t size, size_t limit, std::vector<size_t>& offsets)
+	{
+		::find_pattern(data, size, limit, pattern, offsets);
+	});
+
+	Table table({{"ADDRESS", Table::address(_data->is_32bit)}, {"USAGE", ::usage_formatter(_data)}});
+	table.reserve(addresses.size());
+	for (const auto address : addresses)
+		table.push_back({address, address});
+	return table;
+}
+
+Table Minidump::print_references(uint64_t address, uint64_t size) const
+{
+	const auto word_size = _data->is_32bit ? 4u : 8u;
+	const auto addresses = ::scan_memory(*_data, 0,
+		[this, address, size, word_size](uint64_t base, const uint8_t* data, size_t data_size, size_t, std::vector<size_t>& offsets)
+	{
+		const auto skip = (word_size - base % word_size) % word_size;
+		if (data_size <= skip)
+			return;
+		const auto first = offsets.size();
+		::find_values(data + skip, data_size - skip, _data->is_32bit, address, size, offsets);
+		for (auto i = first; i < offsets.size(); ++i)
+			offsets[i] += skip;
+	});
+
+	Table table({{"ADDRESS", Table::address(_data->is_32bit)}, {"VALUE", Table::address(_data->is_32bit)}, {"USAGE", ::usage_formatter(_data)}});
+	table.reserve(addresses.size());
+	for (const auto reference : addresses)
+	{
+		uint64_t value = 0;
+		_data->memory_reader.read(reference, &value, word_size);
+		table.push_back({
+			reference,
+			value,
+			reference,
+		});
+	}
+	return table;
+}
+
+Table Minidump::print_signature(unsigned long frame_count) const
+{
+	if (!_data->exception)
+		throw std::runtime_error("The dump has no exception");
+
+	// Only walked frames are used because scanned ones depend on stale stack contents.
+	// Addresses are made module-relative so that the signature doesn't depend on image load addresses.
+	uint64_t scan_start = 0;
+	auto chain = ::build_call_chain(*_data, *_data->exception->thread, _data->exception.get(), scan_start);
+	if (chain.size() > frame_count)
+		chain.resize(frame_count);
+	const auto module_indices = ::resolve_call_chain(*_data, chain);
+
+	// The signature is the FNV-1a hash of the exception code and the frames, each followed by a newline.
+	auto hash = ::fnv1a(::Fnv1aBasis, ::to_hex(_data->exception->code) + "\n");
+	std::vector<std::string> frames;
+	frames.reserve(chain.size());
+	for (size_t i = 0; i < chain.size(); ++i)
+	{
+		std::string frame = "?";
+		const auto module_index = module_indices[i];
+		if (module_index != AddressIndex::None)
+		{
+			auto name = _data->module_name_by_index(module_index);
+			std::transform(name.begin(), name.end(), name.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+			const auto image_base = module_index < _data->modules.size()
+				? _data->modules[module_index].image_base
+				: _data->unloaded_modules[module_index - _data->modules.size()].image_base;
+			frame = name + "+0x" + ::to_hex_min(chain[i].second - image_base);
+		}
+		hash = ::fnv1a(hash, frame + "\n");
+		frames.emplace_back(std::move(frame));
+	}
+
+	Table table({{""}, {""}});
+	table.push_back({"Signature:", ::to_hex(hash)});
+	table.push_back({"Exception:", _data->exception->to_string(_data->is_32bit)});
+	for (auto& frame : frames)
+		table.push_back({"Frame " + std::to_string(&frame - &frames.front()) + ":", std::move(frame)});
+	table.push_back({"Bytes read:", std::to_string(_data->file.bytes_read())});
+	return table;
+}
+
 Table Minidump::print_thread_call_stack(unsigned long thread_index) const
 {
 	if (thread_index == 0 || thread_index > _data->threads.size())
 		throw std::invalid_argument("Bad thread " + std::to_string(thread_index));
-	return ::print_call_stack(*_data, _data->threads[thread_index - 1], _data->exception.get());
+	return ::print_call_stack(*_data, _symbols.get(), _data->threads[thread_index - 1], _data->exception.get());
 }
 
-void Minidump::print_thread_raw_stack(unsigned long thread_index) const
+void Minidump::print_thread_raw_stack(std::ostream& stream, unsigned long thread_index) const
 {
 	if (thread_index == 0 || thread_index > _data->threads.size())
 		throw std::invalid_argument("Bad thread " + std::to_string(thread_index));
 	const auto& thread = _data->threads[thread_index - 1];
-	::print_end_data(thread.stack_base, reinterpret_cast<uint32_t*>(thread.stack.get()), thread.stack_end - thread.stack_base);
+	const auto stack = thread.stack.data();
+	if (!stack)
+		throw std::runtime_error("Thread " + std::to_string(thread_index) + " stack is not present in the dump");
+	if (_data->is_32bit)
+		::print_end_data(stream, static_cast<uint32_t>(thread.stack_base), reinterpret_cast<const uint32_t*>(stack), thread.stack_end - thread.stack_base);
+	else
+		::print_end_data(stream, thread.stack_base, reinterpret_cast<const uint64_t*>(stack), thread.stack_end - thread.stack_base);
+}
+
+Table Minidump::print_unique_call_stacks() const
+{
+	struct Stack
+	{
+		std::vector<std::pair<uint64_t, uint64_t>> chain;
+		size_t walked_frames = 0;
+		uint64_t hash = ::Fnv1aBasis;
+	};
+
+	// The stacks are walked and hashed in parallel. The hash covers return addresses
+	// and the number of walked frames, so stacks differing only in scanned frames are distinct.
+	std::vector<Stack> stacks(_data->threads.size());
+	::parallel_for(_data->threads.size(), [this, &stacks](size_t index)
+	{
+		const auto& thread = _data->threads[index];
+		if (!::has_call_stack(*_data, thread))
+			return;
+		auto& stack = stacks[index];
+		stack.chain = ::walk_call_stack(*_data, thread, ::thread_exception(*_data, thread), stack.walked_frames);
+		for (const auto& frame : stack.chain)
+			stack.hash = ::fnv1a(stack.hash, frame.second);
+		stack.hash = ::fnv1a(stack.hash, stack.walked_frames);
+	});
+
+	// Threads are grouped by hash, and chains are compared to tell hash collisions apart.
+	std::vector<std::vector<size_t>> groups;
+	std::unordered_map<uint64_t, std::vector<size_t>> groups_by_hash;
+	std::vector<size_t> threads_without_stacks;
+	for (size_t i = 0; i < stacks.size(); ++i)
+	{
+		const auto& stack = stacks[i];
+		if (stack.chain.empty())
+		{
+			threads_without_stacks.emplace_back(i);
+			continue;
+		}
+		auto& candidates = groups_by_hash[stack.hash];
+		const auto same_stack = [&stacks, &stack](size_t group)
+		{
+			const auto& other = stacks[group];
+			return stack.walked_frames == other.walked_frames && std::equal(stack.chain.begin(), stack.chain.end(),
+				other.chain.begin(), other.chain.end(), [](const auto& a, const auto& b) { return a.second == b.second; });
+		};
+		const auto j = std::find_if(candidates.begin(), candidates.end(), [&groups, &same_stack](size_t group) { return same_stack(groups[group].front()); });
+		if (j != candidates.end())
+		{
+			groups[*j].emplace_back(i);
+			continue;
+		}
+		candidates.emplace_back(groups.size());
+		groups.push_back({i});
+	}
+	std::stable_sort(groups.begin(), groups.end(), [](const auto& a, const auto& b) { return a.size() > b.size(); });
+
+	// Only one stack of each group is decoded.
+	std::vector<std::vector<std::string>> group_functions(groups.size());
+	::parallel_for(groups.size(), [this, &stacks, &groups, &group_functions](size_t index)
+	{
+		const auto& stack = stacks[groups[index].front()];
+		const auto module_indices = ::resolve_call_chain(*_data, stack.chain);
+		auto& functions = group_functions[index];
+		functions.reserve(stack.chain.size());
+		for (size_t i = 0; i < stack.chain.size(); ++i)
+			functions.emplace_back((i < stack.walked_frames ? "" : "? ") + decode_code_address(*_data, _symbols.get(), stack.chain[i].second, module_indices[i]));
+	});
+
+	Table table({{"#", Table::Format::Decimal}, {"COUNT", Table::Format::Decimal}, {"FRAME", Table::Format::Decimal}, {"RETURN", Table::address(_data->is_32bit)}, {"FUNCTION"}, {"THREADS"}});
+	for (size_t i = 0; i < groups.size(); ++i)
+	{
+		const auto& threads = groups[i];
+		const auto& stack = stacks[threads.front()];
+		for (size_t j = 0; j < stack.chain.size(); ++j)
+			table.push_back({i + 1, threads.size(), j, stack.chain[j].second, group_functions[i][j], j == 0 ? ::indices_to_string(threads) : ""});
+	}
+	// Threads without call stacks form the last group, so that group counts add up to the thread count.
+	if (!threads_without_stacks.empty())
+		table.push_back({groups.size() + 1, threads_without_stacks.size(), uint64_t{0}, uint64_t{0}, "(no call stack)", ::indices_to_string(threads_without_stacks)});
+	return table;
 }
 
 Table Minidump::print_threads() const
 {
-	Table table({{"#", Table::Alignment::Right}, {"ID"}, {"STACK"}, {"END"}, {"START"}, {"CURRENT"}, {"NOTES"}});
+	Table table({{"#", Table::Format::Decimal}, {"ID", Table::Format::Hex32}, {"STACK", Table::address(_data->is_32bit)}, {"END", Table::address(_data->is_32bit)},
+		{"START", ::code_address_formatter(_data, _symbols)}, {"CURRENT", ::code_address_formatter(_data, _symbols)}, {"NOTES"}});
 	table.reserve(_data->threads.size());
 	for (const auto& thread : _data->threads)
 	{
 		table.push_back({
-			std::to_string(&thread - &_data->threads.front() + 1),
-			::to_hex(thread.id),
-			::to_hex(thread.stack_base, _data->is_32bit),
-			::to_hex(thread.stack_end, _data->is_32bit),
-			decode_code_address(*_data, thread.start_address),
-			decode_code_address(*_data, thread.context->x86.eip),
+			static_cast<uint64_t>(&thread - &_data->threads.front() + 1),
+			thread.id,
+			thread.stack_base,
+			thread.stack_end,
+			thread.start_address,
+			::instruction_pointer(*_data, *thread.context),
 			_data->exception && _data->exception->thread_id == thread.id ? "(exception)" : "",
 		});
 	}
@@ -214,16 +731,16 @@ Table Minidump::print_threads() const
 
 Table Minidump::print_unloaded_modules() const
 {
-	Table table({{"#", Table::Alignment::Right}, {"NAME"}, {"IMAGE"}, {"END"}, {"SIZE", Table::Alignment::Right}});
+	Table table({{"#", Table::Format::Decimal}, {"NAME"}, {"IMAGE", Table::address(_data->is_32bit)}, {"END", Table::address(_data->is_32bit)}, {"SIZE", Table::Format::Hex}});
 	table.reserve(_data->unloaded_modules.size());
 	for (const auto& module : _data->unloaded_modules)
 	{
 		table.push_back({
-			std::to_string(&module - &_data->unloaded_modules.front() + 1),
+			static_cast<uint64_t>(&module - &_data->unloaded_modules.front() + 1),
 			module.file_name,
-			::to_hex(module.image_base, _data->is_32bit),
-			::to_hex(module.image_end, _data->is_32bit),
-			::to_hex_min(module.image_end - module.image_base),
+			module.image_base,
+			module.image_end,
+			module.image_end - module.image_base,
 		});
 	}
 	return table;
@@ -1,16 +1,32 @@
 #pragma once
 
+#include <iosfwd>
 #include <memory>
 #include <string>
 
 class MinidumpData;
+class Symbols;
 class Table;
 
 class Minidump
 {
 public:
 
-	Minidump(const std::string& file_name, bool summary);
+	// Parts of the dump that can be loaded selectively.
+	enum Content : unsigned
+	{
+		Modules         = 1 << 0,
+		Threads         = 1 << 1, // Thread list and thread information.
+		Exception       = 1 << 2, // Implies Threads.
+		Memory          = 1 << 3, // Memory lists, needed for thread stacks. Implies Modules and Threads.
+		MemoryRegions   = 1 << 4,
+		Handles         = 1 << 5,
+		UnloadedModules = 1 << 6,
+		All             = ~0u,
+	};
+
+	// With 'use_index', decoded data is cached in a sidecar index next to the dump.
+	Minidump(const std::string& file_name, bool summary, unsigned content = All, bool use_index = false);
 	~Minidump();
 
 	Minidump() = default;
@@ -19,17 +35,28 @@ public:
 	Minidump& operator=(const Minidump&) = default;
 	Minidump& operator=(Minidump&&) = default;
 
+	// Sets the symbols used to decode code addresses.
+	void set_symbols(const std::shared_ptr<const Symbols>&);
+
+	Table print_all_call_stacks() const;
+	Table print_diff(const std::string& file_name) const;
 	Table print_exception_call_stack() const;
 	Table print_handles() const;
 	Table print_memory() const;
 	Table print_memory_regions() const;
 	Table print_modules() const;
+	Table print_pattern_matches(const std::string& pattern) const;
+	Table print_references(uint64_t address, uint64_t size) const;
+	Table print_signature(unsigned long frame_count) const;
 	Table print_thread_call_stack(unsigned long thread_index) const;
-	void print_thread_raw_stack(unsigned long thread_index) const;
+	void print_memory_data(std::ostream&, uint64_t address, uint64_t size) const;
+	void print_thread_raw_stack(std::ostream&, unsigned long thread_index) const;
 	Table print_threads() const;
+	Table print_unique_call_stacks() const;
 	Table print_unloaded_modules() const;
 
 private:
 
-	const std::unique_ptr<MinidumpData> _data;
+	std::shared_ptr<const MinidumpData> _data; // Shared by copies, which may be used concurrently.
+	std::shared_ptr<const Symbols> _symbols;
 };
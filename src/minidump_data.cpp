@@ -1,22 +1,28 @@
 #include "minidump_data.h"
 #include "check.h"
+#include "dump_index.h"
 #include "file.h"
+#include "minidump.h"
 #include "minidump_format.h"
+#include "parallel.h"
 #include "utils.h"
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
 #include <cstring>
 #include <iostream>
+#include <iterator>
+#include <set>
 
 namespace
 {
 	// End of 32-bit address range.
 	constexpr auto End32 = uint64_t{UINT32_MAX} + 1;
 
-	template <typename T>
-	std::unique_ptr<T, void(*)(void*)> allocate_pod(size_t size)
-	{
-		return { static_cast<T*>(::calloc(size, 1)), ::free };
-	}
+	// FIXME: Some 32-bit dumps contain weird memory in range 0xfffffffffff00000 - 0xffffffffffff0000.
+	// It doesn't make a dump 64-bit and is dropped once all streams are loaded if the dump is 32-bit.
+	constexpr uint64_t WeirdMemoryBase = 0xfffffffffff00000;
 
 	std::string stream_name(minidump::Stream::Type type)
 	{
@@ -59,26 +65,28 @@ namespace
 		}
 	}
 
-	std::unique_ptr<MinidumpData::Context> load_thread_context(File& file, const minidump::Location& location)
+	std::unique_ptr<MinidumpData::Context> load_thread_context(const File& file, const minidump::Location& location)
 	{
 		auto result = std::make_unique<MinidumpData::Context>();
 		minidump::ThreadContext context;
-		CHECK(file.seek(location.offset), "Bad thread context offset");
 		switch (location.size)
 		{
 		case sizeof context.x86:
-			CHECK(file.read(context.x86), "Couldn't read x86 thread context");
+			CHECK(file.read_at(location.offset, context.x86), "Couldn't read x86 thread context");
 			CHECK(::has_flags(context.x86.context_flags, minidump::ThreadContext::X86 | minidump::ThreadContext::Control), "Bad x86 thread context");
 			result->x86.eip = context.x86.eip;
 			result->x86.esp = context.x86.esp;
 			result->x86.ebp = context.x86.ebp;
 			break;
-		case sizeof context.x64: // Assuming WoW64.
-			CHECK(file.read(context.x64), "Couldn't read x64 thread context");
+		case sizeof context.x64:
+			CHECK(file.read_at(location.offset, context.x64), "Couldn't read x64 thread context");
 			CHECK(::has_flags(context.x64.context_flags, minidump::ThreadContext::X64 | minidump::ThreadContext::Control), "Bad x64 thread context");
 			result->x86.eip = context.x64.rip;
 			result->x86.esp = context.x64.rsp;
 			result->x86.ebp = context.x64.rbp;
+			result->x64.rip = context.x64.rip;
+			static_assert(offsetof(decltype(context.x64), r15) - offsetof(decltype(context.x64), rax) == sizeof result->x64.registers - 8, "Bad x64 context layout");
+			::memcpy(result->x64.registers, &context.x64.rax, sizeof result->x64.registers);
 			break;
 		default:
 			CHECK(false, "Bad thread context size " << location.size);
@@ -86,22 +94,50 @@ namespace
 		return result;
 	}
 
-	std::u16string read_string(File& file, uint32_t offset)
+	std::string read_string(const File& file, uint32_t offset)
 	{
-		minidump::StringHeader header;
-		CHECK(file.seek(offset), "Bad string offset");
-		CHECK(file.read(header), "Couldn't read string header");
-		if (!header.size)
+		const auto header = file.view<minidump::StringHeader>(offset);
+		CHECK(header, "Bad string offset");
+		if (!header->size)
 			return {};
-		std::u16string string(header.size / 2, u' ');
-		CHECK(file.read(const_cast<char16_t*>(string.data()), header.size), "Couldn't read string");
-		return std::move(string);
+		const auto string = file.view<char16_t>(offset + sizeof *header, header->size / 2);
+		CHECK(string, "Couldn't read string");
+		return ::to_ascii(string, header->size / 2);
 	}
 
 	std::string to_range(uint64_t base, uint64_t size)
 	{
 		return std::to_string(base) + "~" + std::to_string(base + size - 1);
 	}
+
+	// Builds the data derived from loaded streams.
+	void link_data(MinidumpData& dump)
+	{
+		if (dump.exception)
+		{
+			const auto i = std::find_if(dump.threads.begin(), dump.threads.end(), [&dump](const auto& thread)
+			{
+				return thread.id == dump.exception->thread_id;
+			});
+			CHECK(i != dump.threads.end(), "Exception in unknown thread");
+			dump.exception->thread = &*i;
+		}
+
+		std::vector<AddressIndex::Range> module_ranges;
+		module_ranges.reserve(dump.modules.size() + dump.unloaded_modules.size());
+		for (const auto& module : dump.modules)
+			module_ranges.push_back({module.image_base, module.image_end, module_ranges.size()});
+		// Unloaded module ranges may have been reused by loaded modules and by more recently unloaded ones.
+		for (auto i = dump.unloaded_modules.size(); i > 0; --i)
+			module_ranges.push_back({dump.unloaded_modules[i - 1].image_base, dump.unloaded_modules[i - 1].image_end, dump.modules.size() + i - 1});
+		dump.module_index = AddressIndex(module_ranges);
+
+		std::vector<std::pair<uint64_t, uint64_t>> images;
+		images.reserve(dump.modules.size());
+		for (const auto& module : dump.modules)
+			images.emplace_back(module.image_base, module.image_end);
+		dump.images = ImageTables(dump.memory_reader, std::move(images));
+	}
 }
 
 namespace
@@ -109,41 +145,43 @@ namespace
 	class Loader
 	{
 	public:
-		Loader(bool summary) : _summary(summary) {}
+		Loader(bool summary, unsigned content) : _summary(summary), _content(summary ? Minidump::All : content) {}
 
 		std::unique_ptr<MinidumpData> load(const std::string& file_name);
 
 	private:
-		void load_exception(MinidumpData&, File&, const minidump::Stream&);
-		void load_handle_data(MinidumpData&, File&, const minidump::Stream&);
-		void load_memory_info_list(MinidumpData&, File&, const minidump::Stream&);
-		void load_memory_list(MinidumpData&, File&, const minidump::Stream&);
-		void load_memory64_list(MinidumpData&, File&, const minidump::Stream&);
-		void load_misc_info(MinidumpData&, File&, const minidump::Stream&);
-		void load_module_list(MinidumpData&, File&, const minidump::Stream&);
-		void load_system_info(MinidumpData&, File&, const minidump::Stream&);
-		void load_system_memory_info(MinidumpData&, File&, const minidump::Stream&);
-		void load_thread_list(MinidumpData&, File&, const minidump::Stream&);
-		void load_thread_info_list(MinidumpData&, File&, const minidump::Stream&);
-		void load_tokens(MinidumpData&, File&, const minidump::Stream&);
-		void load_unloaded_module_list(MinidumpData&, File&, const minidump::Stream&);
-		void load_vm_counters(MinidumpData&, File&, const minidump::Stream&);
+		void load_exception(MinidumpData&, const File&, const minidump::Stream&);
+		void load_handle_data(MinidumpData&, const File&, const minidump::Stream&);
+		void load_memory_info_list(MinidumpData&, const File&, const minidump::Stream&);
+		void load_memory_list(MinidumpData&, const File&, const minidump::Stream&);
+		void load_memory64_list(MinidumpData&, const File&, const minidump::Stream&);
+		void load_misc_info(MinidumpData&, const File&, const minidump::Stream&);
+		void load_module_list(MinidumpData&, const File&, const minidump::Stream&);
+		void load_system_info(MinidumpData&, const File&, const minidump::Stream&);
+		void load_system_memory_info(MinidumpData&, const File&, const minidump::Stream&);
+		void load_thread_list(MinidumpData&, const File&, const minidump::Stream&);
+		void load_thread_info_list(MinidumpData&, const File&, const minidump::Stream&);
+		void load_tokens(MinidumpData&, const File&, const minidump::Stream&);
+		void load_unloaded_module_list(MinidumpData&, const File&, const minidump::Stream&);
+		void load_vm_counters(MinidumpData&, const File&, const minidump::Stream&);
 
 	private:
 		const bool _summary;
-		std::vector<std::tuple<uint64_t, uint64_t, uint8_t*>> _loading_stacks;
+		const unsigned _content;
+		std::atomic<bool> _is_32bit{ true };
 		std::unique_ptr<std::pair<uint64_t, uint64_t>> _wow64_ntdll;
+		std::vector<MemoryReader::Range> _memory_ranges;
 	};
 
 	std::unique_ptr<MinidumpData> Loader::load(const std::string& file_name)
 	{
-		File file(file_name);
-		CHECK(file, "Couldn't open \"" << file_name << "\"");
-
 		auto dump = std::make_unique<MinidumpData>();
+		dump->file = File(file_name);
+		CHECK(dump->file, "Couldn't open \"" << file_name << "\"");
+		const auto& file = dump->file;
 
 		minidump::Header header;
-		CHECK(file.read(header), "Couldn't read header");
+		CHECK(file.read_at(0, header), "Couldn't read header");
 		CHECK_EQ(header.signature, minidump::Header::Signature, "Header signature mismatch");
 		CHECK_EQ(header.version, minidump::Header::Version, "Header version mismatch");
 
@@ -183,8 +221,7 @@ namespace
 		dump->timestamp = header.timestamp;
 
 		std::vector<minidump::Stream> streams(header.stream_count);
-		CHECK(file.seek(header.stream_list_offset), "Bad stream list offset");
-		CHECK(file.read(streams.data(), streams.size() * sizeof(minidump::Stream)), "Couldn't read stream list");
+		CHECK(file.read_at(header.stream_list_offset, streams.data(), streams.size() * sizeof(minidump::Stream)), "Couldn't read stream list");
 		if (_summary)
 		{
 			std::cout << "\nMINIDUMP_DIRECTORY: # " << ::to_range(header.stream_list_offset, streams.size() * sizeof(minidump::Stream));
@@ -194,7 +231,7 @@ namespace
 		}
 		std::sort(streams.begin(), streams.end(), [](const minidump::Stream& a, const minidump::Stream& b) { return a.location.offset < b.location.offset; });
 
-		static const std::map<minidump::Stream::Type, void (Loader::*)(MinidumpData&, File&, const minidump::Stream&)> handlers =
+		static const std::map<minidump::Stream::Type, void (Loader::*)(MinidumpData&, const File&, const minidump::Stream&)> handlers =
 		{
 			{ minidump::Stream::Type::ThreadList, &Loader::load_thread_list },
 			{ minidump::Stream::Type::ModuleList, &Loader::load_module_list },
@@ -212,6 +249,57 @@ namespace
 			{ minidump::Stream::Type::ProcessVmCounters, &Loader::load_vm_counters },
 		};
 
+		// Streams that must be loaded before the stream of the specified type.
+		static const std::multimap<minidump::Stream::Type, minidump::Stream::Type> dependencies =
+		{
+			{ minidump::Stream::Type::Memory64List, minidump::Stream::Type::ModuleList }, // WoW64 ntdll.dll range is needed to detect 64-bit memory.
+			{ minidump::Stream::Type::Memory64List, minidump::Stream::Type::MemoryList }, // Both lists fill the same memory map.
+			{ minidump::Stream::Type::MemoryList, minidump::Stream::Type::ModuleList },
+			{ minidump::Stream::Type::MemoryInfoList, minidump::Stream::Type::ModuleList },
+			{ minidump::Stream::Type::ThreadInfoList, minidump::Stream::Type::ThreadList },
+		};
+
+		std::set<minidump::Stream::Type> selected_streams;
+		if (_content == Minidump::All)
+		{
+			for (const auto& handler : handlers)
+				selected_streams.emplace(handler.first);
+		}
+		else
+		{
+			selected_streams.emplace(minidump::Stream::Type::SystemInfo); // Validates CPU architecture.
+			if (_content & (Minidump::Modules | Minidump::Memory))
+				selected_streams.emplace(minidump::Stream::Type::ModuleList);
+			if (_content & (Minidump::Threads | Minidump::Exception | Minidump::Memory))
+			{
+				selected_streams.emplace(minidump::Stream::Type::ThreadList);
+				selected_streams.emplace(minidump::Stream::Type::ThreadInfoList);
+			}
+			if (_content & Minidump::Exception)
+				selected_streams.emplace(minidump::Stream::Type::Exception);
+			if (_content & Minidump::Memory)
+			{
+				selected_streams.emplace(minidump::Stream::Type::MemoryList);
+				selected_streams.emplace(minidump::Stream::Type::Memory64List);
+			}
+			if (_content & Minidump::MemoryRegions)
+				selected_streams.emplace(minidump::Stream::Type::MemoryInfoList);
+			if (_content & Minidump::Handles)
+				selected_streams.emplace(minidump::Stream::Type::HandleData);
+			if (_content & Minidump::UnloadedModules)
+				selected_streams.emplace(minidump::Stream::Type::UnloadedModuleList);
+			for (std::vector<minidump::Stream::Type> pending(selected_streams.begin(), selected_streams.end()); !pending.empty(); )
+			{
+				const auto dependency_types = dependencies.equal_range(pending.back());
+				pending.pop_back();
+				for (auto i = dependency_types.first; i != dependency_types.second; ++i)
+					if (selected_streams.emplace(i->second).second)
+						pending.emplace_back(i->second);
+			}
+		}
+
+		TaskGraph tasks;
+		std::multimap<minidump::Stream::Type, size_t> stream_tasks;
 		for (const auto& stream : streams)
 		{
 			if (stream.type == minidump::Stream::Type::Unused && stream.location.offset == 0 && stream.location.size == 0)
@@ -219,38 +307,53 @@ namespace
 			const auto i = handlers.find(stream.type);
 			if (i != handlers.end())
 			{
-				(this->*i->second)(*dump, file, stream);
+				if (!selected_streams.count(stream.type))
+					continue;
+				const auto handler = i->second;
+				const auto task = tasks.add([this, handler, &dump, &file, &stream] { (this->*handler)(*dump, file, stream); });
+				const auto same_type = stream_tasks.equal_range(stream.type);
+				if (same_type.first != same_type.second)
+					tasks.depend(task, std::prev(same_type.second)->second);
+				stream_tasks.emplace(stream.type, task);
 			}
-			else
+			else if (_content == Minidump::All)
 			{
 				std::cerr << "WARNING: Skipped stream " << ::stream_name(stream.type)
 					<< " (" << stream.location.size << " bytes at 0x" << ::to_hex(stream.location.offset) << ")" << std::endl;
 			}
 		}
-
-		CHECK(dump->is_32bit, "64-bit dumps are not supported");
-		CHECK(_loading_stacks.empty(), "Failed to load all stacks");
-
-		if (dump->exception)
+		for (const auto& task : stream_tasks)
 		{
-			const auto i = std::find_if(dump->threads.begin(), dump->threads.end(), [&dump](const auto& thread)
+			const auto dependency_types = dependencies.equal_range(task.first);
+			for (auto i = dependency_types.first; i != dependency_types.second; ++i)
 			{
-				return thread.id == dump->exception->thread_id;
-			});
-			CHECK(i != dump->threads.end(), "Exception in unknown thread");
-			dump->exception->thread = &*i;
+				const auto dependency_tasks = stream_tasks.equal_range(i->second);
+				for (auto j = dependency_tasks.first; j != dependency_tasks.second; ++j)
+					tasks.depend(task.second, j->second);
+			}
 		}
+		tasks.run(_summary ? 1 : 0); // Summary output must not be interleaved.
+
+		// Streams that decide the bitness may be loaded concurrently with the memory lists, so weird memory is dropped only now.
+		dump->is_32bit = _is_32bit;
+		if (dump->is_32bit)
+		{
+			dump->memory.erase(dump->memory.lower_bound(WeirdMemoryBase), dump->memory.end());
+			dump->memory_regions.erase(dump->memory_regions.lower_bound(WeirdMemoryBase), dump->memory_regions.end());
+			_memory_ranges.erase(std::remove_if(_memory_ranges.begin(), _memory_ranges.end(),
+				[](const MemoryReader::Range& range) { return range.base >= WeirdMemoryBase; }), _memory_ranges.end());
+		}
+		dump->memory_reader = MemoryReader(file, std::move(_memory_ranges));
+
+		::link_data(*dump);
 
 		for (auto& memory_range : dump->memory)
 		{
-			for (const auto& module : dump->modules)
+			const auto module_index = dump->module_index.find(memory_range.first);
+			if (module_index < dump->modules.size() && memory_range.second.end <= dump->modules[module_index].image_end)
 			{
-				if (memory_range.first >= module.image_base && memory_range.second.end <= module.image_end)
-				{
-					memory_range.second.usage = MinidumpData::MemoryInfo::Usage::Image;
-					memory_range.second.usage_index = &module - &dump->modules.front() + 1;
-					break;
-				}
+				memory_range.second.usage = MinidumpData::MemoryInfo::Usage::Image;
+				memory_range.second.usage_index = module_index + 1;
 			}
 			if (memory_range.second.usage != MinidumpData::MemoryInfo::Usage::Unknown)
 				continue;
@@ -268,14 +371,13 @@ namespace
 		return dump;
 	}
 
-	void Loader::load_exception(MinidumpData& dump, File& file, const minidump::Stream& stream)
+	void Loader::load_exception(MinidumpData& dump, const File& file, const minidump::Stream& stream)
 	{
 		CHECK(!dump.exception, "Duplicate exception");
 
 		minidump::ExceptionStream exception;
 		CHECK(stream.location.size >= sizeof exception, "Bad exception stream");
-		CHECK(file.seek(stream.location.offset), "Bad exception offset");
-		CHECK(file.read(exception), "Couldn't read exception");
+		CHECK(file.read_at(stream.location.offset, exception), "Couldn't read exception");
 		check_extra_data(stream, sizeof exception);
 
 		auto&& result = std::make_unique<MinidumpData::Exception>();
@@ -300,31 +402,29 @@ namespace
 				CHECK(false, "Bad access violation access type (0x" << ::to_hex(exception.ExceptionRecord.ExceptionInformation[0]) << ")");
 			}
 			result->address = exception.ExceptionRecord.ExceptionInformation[1];
-			if (dump.is_32bit && result->address >= End32)
-				dump.is_32bit = false;
+			if (_is_32bit && result->address >= End32)
+				_is_32bit = false;
 		}
 
 		dump.exception = std::move(result);
 	}
 
-	void Loader::load_handle_data(MinidumpData& dump, File& file, const minidump::Stream& stream)
+	void Loader::load_handle_data(MinidumpData& dump, const File& file, const minidump::Stream& stream)
 	{
 		CHECK(dump.handles.empty(), "Duplicate handle data list");
 
 		minidump::HandleDataHeader header;
 		CHECK(stream.location.size >= sizeof header, "Bad handle data stream");
-		CHECK(file.seek(stream.location.offset), "Bad handle data list offset");
-		CHECK(file.read(header), "Couldn't read handle data list header");
+		CHECK(file.read_at(stream.location.offset, header), "Couldn't read handle data list header");
 		CHECK_GE(header.entry_count, 0, "Bad handle data list size");
 		CHECK_GE(header.entry_size, sizeof(minidump::HandleData), "Bad handle data size");
 
 		minidump::HandleData2 entry;
-		const auto entry_size = std::min(sizeof entry, header.entry_size);
+		const auto entry_size = std::min<size_t>(sizeof entry, header.entry_size);
 		const auto base = stream.location.offset + header.header_size;
 		for (uint32_t i = 0; i < header.entry_count; ++i)
 		{
-			CHECK(file.seek(base + i * header.entry_size), "Bad handle data list");
-			CHECK(file.read(&entry, entry_size), "Couldn't read handle data");
+			CHECK(file.read_at(base + i * header.entry_size, &entry, entry_size), "Couldn't read handle data");
 
 			MinidumpData::Handle handle;
 			handle.handle = entry.handle;
@@ -332,7 +432,7 @@ namespace
 			{
 				try
 				{
-					handle.type_name = ::to_ascii(::read_string(file, entry.type_name_offset));
+					handle.type_name = ::read_string(file, entry.type_name_offset);
 				}
 				catch (const BadCheck& e)
 				{
@@ -343,7 +443,7 @@ namespace
 			{
 				try
 				{
-					handle.type_name = ::to_ascii(::read_string(file, entry.object_name_offset));
+					handle.object_name = ::read_string(file, entry.object_name_offset);
 				}
 				catch (const BadCheck& e)
 				{
@@ -354,14 +454,13 @@ namespace
 		}
 	}
 
-	void Loader::load_memory_info_list(MinidumpData& dump, File& file, const minidump::Stream& stream)
+	void Loader::load_memory_info_list(MinidumpData& dump, const File& file, const minidump::Stream& stream)
 	{
 		CHECK(dump.memory_regions.empty(), "Duplicate memory info list");
 
 		minidump::MemoryInfoListHeader header;
 		CHECK(stream.location.size >= sizeof header, "Bad memory info list stream");
-		CHECK(file.seek(stream.location.offset), "Bad memory info list offset");
-		CHECK(file.read(header), "Couldn't read memory info list header");
+		CHECK(file.read_at(stream.location.offset, header), "Couldn't read memory info list header");
 		CHECK_GE(header.header_size, sizeof header, "Bad memory info list header size");
 
 		minidump::MemoryInfo memory_info;
@@ -369,8 +468,7 @@ namespace
 		const auto base = stream.location.offset + header.header_size;
 		for (uint32_t i = 0; i < header.entry_count; ++i)
 		{
-			CHECK(file.seek(base + i * header.entry_size), "Bad memory info list");
-			CHECK(file.read(memory_info), "Couldn't read memory info entry");
+			CHECK(file.read_at(base + i * header.entry_size, memory_info), "Couldn't read memory info entry");
 
 			MinidumpData::MemoryRegion m;
 			m.end = memory_info.base + memory_info.size;
@@ -397,16 +495,12 @@ namespace
 				CHECK(memory_info.state == minidump::MemoryInfo::State::Free, "Bad undefined memory state (0x" << ::to_hex(::to_raw(memory_info.state)) << ")");
 			}
 
-			if (dump.is_32bit && m.end > End32 && !(_wow64_ntdll
+			if (_is_32bit && m.end > End32 && !(_wow64_ntdll
 				&& ((memory_info.base == 0x000000007fff0000 && m.end == _wow64_ntdll->first)
 					|| (memory_info.base >= _wow64_ntdll->first && m.end <= _wow64_ntdll->second)
-					|| (memory_info.base == _wow64_ntdll->second && m.end == 0x00007fffffff0000))))
-			{
-				// FIXME: Some 32-bit dumps contain weird memory in range 0xfffffffffff00000 - 0xffffffffffff0000.
-				if (memory_info.base >= 0xfffffffffff00000)
-					continue;
-				dump.is_32bit = false;
-			}
+					|| (memory_info.base == _wow64_ntdll->second && m.end == 0x00007fffffff0000)))
+				&& memory_info.base < WeirdMemoryBase)
+				_is_32bit = false;
 
 			// NOTE: Temporary collapsing code.
 			const auto j = std::find_if(dump.memory_regions.rbegin(), dump.memory_regions.rend(), [&memory_info](const auto& memory_region)
@@ -420,89 +514,57 @@ namespace
 		}
 	}
 
-	void Loader::load_memory_list(MinidumpData& dump, File& file, const minidump::Stream& stream)
+	void Loader::load_memory_list(MinidumpData& dump, const File& file, const minidump::Stream& stream)
 	{
-		CHECK(!dump.threads.empty(), "Loading memory/memory64 list before thread list is not supported");
 		CHECK(dump.memory.empty(), "Duplicate memory/memory64 list");
 
 		minidump::MemoryListHeader header;
 		CHECK(stream.location.size >= sizeof header, "Bad memory/memory64 list stream");
-		CHECK(file.seek(stream.location.offset), "Bad memory/memory64 list offset");
-		CHECK(file.read(header), "Couldn't read memory/memory64 list header");
+		CHECK(file.read_at(stream.location.offset, header), "Couldn't read memory/memory64 list header");
 		CHECK_GE(header.entry_count, 0, "Bad memory/memory64 list size");
 
-		std::vector<minidump::MemoryRange> memory(header.entry_count);
-		CHECK(file.read(memory.data(), memory.size() * sizeof(minidump::MemoryRange)), "Couldn't read memory/memory64 list");
-		for (const auto& memory_range : memory)
+		const auto memory = file.view<minidump::MemoryRange>(stream.location.offset + sizeof header, header.entry_count);
+		CHECK(memory, "Couldn't read memory/memory64 list");
+		for (uint32_t j = 0; j < header.entry_count; ++j)
 		{
+			const auto& memory_range = memory[j];
 			MinidumpData::MemoryInfo m;
 			m.end = uint64_t{memory_range.base} + memory_range.location.size;
-			CHECK(m.end <= End32, "Bad memory list");
+			if (_is_32bit && m.end > End32 && !(_wow64_ntdll && memory_range.base >= _wow64_ntdll->first && m.end <= _wow64_ntdll->second))
+				_is_32bit = false;
+			_memory_ranges.push_back({ memory_range.base, m.end, memory_range.location.offset });
 			dump.memory.emplace(memory_range.base, std::move(m));
-
-			for (auto i = _loading_stacks.begin(); i != _loading_stacks.end(); )
-			{
-				const auto stack_base = std::get<0>(*i);
-				const auto stack_end = std::get<1>(*i);
-				if (stack_base >= memory_range.base && stack_end <= memory_range.base + memory_range.location.size)
-				{
-					CHECK(file.seek(memory_range.location.offset + (stack_base - memory_range.base)), "Alarm!");
-					CHECK(file.read(std::get<2>(*i), stack_end - stack_base), "Alarm!");
-					i = _loading_stacks.erase(i);
-				}
-				else
-					++i;
-			}
 		}
 	}
 
-	void Loader::load_memory64_list(MinidumpData& dump, File& file, const minidump::Stream& stream)
+	void Loader::load_memory64_list(MinidumpData& dump, const File& file, const minidump::Stream& stream)
 	{
-		CHECK(!dump.threads.empty(), "Loading memory/memory64 list before thread list is not supported");
-		CHECK(!dump.modules.empty(), "Loading memory/memory64 list before module list is not supported");
 		CHECK(dump.memory.empty(), "Duplicate memory/memory64 list");
 
 		minidump::Memory64ListHeader header;
 		CHECK(stream.location.size >= sizeof header, "Bad memory/memory64 list stream");
-		CHECK(file.seek(stream.location.offset), "Bad memory/memory64 list offset");
-		CHECK(file.read(header), "Couldn't read memory/memory64 list header");
+		CHECK(file.read_at(stream.location.offset, header), "Couldn't read memory/memory64 list header");
 		CHECK_GE(header.entry_count, 0, "Bad memory/memory64 list size");
 
-		std::vector<minidump::Memory64Range> memory(header.entry_count);
-		CHECK(file.read(memory.data(), memory.size() * sizeof(minidump::Memory64Range)), "Couldn't read memory/memory64 list");
+		const auto memory = file.view<minidump::Memory64Range>(stream.location.offset + sizeof header, header.entry_count);
+		CHECK(memory, "Couldn't read memory/memory64 list");
 		auto offset = header.offset;
-		for (const auto& memory_range : memory)
+		for (uint64_t j = 0; j < header.entry_count; ++j)
 		{
+			const auto& memory_range = memory[j];
+			const auto range_offset = offset; // Skipped ranges still occupy space in the file.
+			offset += memory_range.size;
 			MinidumpData::MemoryInfo m;
 			m.end = memory_range.base + memory_range.size;
-			if (dump.is_32bit && m.end > End32 && !(_wow64_ntdll && memory_range.base >= _wow64_ntdll->first && m.end <= _wow64_ntdll->second))
-			{
-				// FIXME: Some 32-bit dumps contain weird memory in range 0xfffffffffff00000 - 0xffffffffffff0000.
-				if (memory_range.base >= 0xfffffffffff00000)
-					continue;
-				dump.is_32bit = false;
-			}
+			if (_is_32bit && m.end > End32 && !(_wow64_ntdll && memory_range.base >= _wow64_ntdll->first && m.end <= _wow64_ntdll->second)
+				&& memory_range.base < WeirdMemoryBase)
+				_is_32bit = false;
+			_memory_ranges.push_back({ memory_range.base, m.end, range_offset });
 			dump.memory.emplace(memory_range.base, std::move(m));
-
-			for (auto i = _loading_stacks.begin(); i != _loading_stacks.end(); )
-			{
-				const auto stack_base = std::get<0>(*i);
-				const auto stack_end = std::get<1>(*i);
-				if (stack_base >= memory_range.base && stack_end <= memory_range.base + memory_range.size)
-				{
-					CHECK(file.seek(offset + (stack_base - memory_range.base)), "Bad stack data");
-					CHECK(file.read(std::get<2>(*i), stack_end - stack_base), "Couldn't read stack data");
-					i = _loading_stacks.erase(i);
-				}
-				else
-					++i;
-			}
-
-			offset += memory_range.size;
 		}
 	}
 
-	void Loader::load_misc_info(MinidumpData& dump, File& file, const minidump::Stream& stream)
+	void Loader::load_misc_info(MinidumpData& dump, const File& file, const minidump::Stream& stream)
 	{
 		minidump::MiscInfo5 misc_info;
 		CHECK(stream.location.size == sizeof(minidump::MiscInfo)
@@ -510,8 +572,7 @@ namespace
 			|| stream.location.size == sizeof(minidump::MiscInfo3)
 			|| stream.location.size == sizeof(minidump::MiscInfo4)
 			|| stream.location.size >= sizeof(minidump::MiscInfo5), "Bad misc info stream");
-		CHECK(file.seek(stream.location.offset), "Bad misc info offset");
-		CHECK(file.read(&misc_info, std::min(stream.location.size, sizeof misc_info)), "Couldn't read misc info");
+		CHECK(file.read_at(stream.location.offset, &misc_info, std::min<size_t>(stream.location.size, sizeof misc_info)), "Couldn't read misc info");
 		check_extra_data(stream, sizeof misc_info);
 
 		if (_summary)
@@ -525,7 +586,7 @@ namespace
 			case sizeof(minidump::MiscInfo5): std::cout << "\nMINIDUMP_MISC_INFO_5"; break;
 			default: std::cout << "\nMINIDUMP_MISC_INFO_5+"; break;
 			}
-			std::cout << ": # " << ::to_range(stream.location.offset, std::min(stream.location.size, sizeof misc_info));
+			std::cout << ": # " << ::to_range(stream.location.offset, std::min<size_t>(stream.location.size, sizeof misc_info));
 			std::cout << "\n\tFlags1: 0x" << ::to_hex(misc_info.flags);
 			if (misc_info.flags & 0x00000001) std::cout << "\n\t\t- MINIDUMP_MISC1_PROCESS_ID";
 			if (misc_info.flags & 0x00000002) std::cout << "\n\t\t- MINIDUMP_MISC1_PROCESS_TIMES";
@@ -585,7 +646,7 @@ namespace
 		}
 	}
 
-	void Loader::load_module_list(MinidumpData& dump, File& file, const minidump::Stream& stream)
+	void Loader::load_module_list(MinidumpData& dump, const File& file, const minidump::Stream& stream)
 	{
 		const auto version_to_string = [](const uint16_t (&parts)[4]) -> std::string
 		{
@@ -598,24 +659,25 @@ namespace
 
 		minidump::ModuleListHeader header;
 		CHECK(stream.location.size >= sizeof header, "Bad module list stream");
-		CHECK(file.seek(stream.location.offset), "Bad module list offset");
-		CHECK(file.read(header), "Couldn't read module list header");
+		CHECK(file.read_at(stream.location.offset, header), "Couldn't read module list header");
 		CHECK_GE(header.entry_count, 0, "Bad module list size");
 
-		std::vector<minidump::Module> modules(header.entry_count);
-		CHECK(file.read(modules.data(), modules.size() * sizeof(minidump::Module)), "Couldn't read module list");
-		for (const auto& module : modules)
+		const auto modules = file.view<minidump::Module>(stream.location.offset + sizeof header, header.entry_count);
+		CHECK(modules, "Couldn't read module list");
+		for (auto module = modules; module != modules + header.entry_count; ++module)
 		{
-			if (!module.version_info.signature && !module.version_info.version)
+			if (!module->version_info.signature && !module->version_info.version)
 				continue; // No version information is present.
-			CHECK_EQ(module.version_info.signature, minidump::Module::VersionInfo::Signature, "Bad module version signature");
-			CHECK_EQ(module.version_info.version, minidump::Module::VersionInfo::Version, "Bad module version version");
+			CHECK_EQ(module->version_info.signature, minidump::Module::VersionInfo::Signature, "Bad module version signature");
+			CHECK_EQ(module->version_info.version, minidump::Module::VersionInfo::Version, "Bad module version version");
 		}
 
-		for (const auto& module : modules)
+		dump.modules.reserve(header.entry_count);
+		for (uint32_t i = 0; i < header.entry_count; ++i)
 		{
+			const auto& module = modules[i];
 			MinidumpData::Module m;
-			m.file_path = ::to_ascii(::read_string(file, module.name_offset));
+			m.file_path = ::read_string(file, module.name_offset);
 			m.file_name = m.file_path.substr(m.file_path.find_last_of('\\') + 1);
 			if (module.version_info.signature)
 			{
@@ -630,11 +692,11 @@ namespace
 				try
 				{
 					CHECK_GE(module.cv_record.size, minidump::CodeViewRecordPDB70::MinSize, "Bad PDB reference size");
-					const auto& cv = ::allocate_pod<minidump::CodeViewRecordPDB70>(module.cv_record.size + 1);
-					CHECK(file.seek(module.cv_record.offset), "Bad PDB reference");
-					CHECK(file.read(cv.get(), module.cv_record.size), "Couldn't read PDB reference");
-					m.pdb_path = cv->pdb_name;
+					const auto cv = static_cast<const minidump::CodeViewRecordPDB70*>(file.view(module.cv_record.offset, module.cv_record.size));
+					CHECK(cv, "Bad PDB reference");
+					m.pdb_path.assign(cv->pdb_name, ::strnlen(cv->pdb_name, module.cv_record.size - minidump::CodeViewRecordPDB70::MinSize));
 					m.pdb_name = m.pdb_path.substr(m.pdb_path.find_last_of('\\') + 1);
+					m.pdb_id = ::to_pdb_id(cv->pdb_guid, cv->pdb_age);
 				}
 				catch (const BadCheck& e)
 				{
@@ -648,18 +710,24 @@ namespace
 				CHECK(!_wow64_ntdll, "Duplicate WoW64 ntdll.dll");
 				_wow64_ntdll = std::make_unique<std::pair<uint64_t, uint64_t>>(m.image_base, m.image_end);
 			}
-			else if (dump.is_32bit && m.image_end > End32)
-				dump.is_32bit = true;
 			dump.modules.emplace_back(std::move(m));
 		}
+
+		for (const auto& module : dump.modules)
+		{
+			if (module.image_end > End32 && !(_wow64_ntdll && module.image_base == _wow64_ntdll->first))
+			{
+				_is_32bit = false;
+				break;
+			}
+		}
 	}
 
-	void Loader::load_system_info(MinidumpData& dump, File& file, const minidump::Stream& stream)
+	void Loader::load_system_info(MinidumpData& dump, const File& file, const minidump::Stream& stream)
 	{
 		minidump::SystemInfo system_info;
 		CHECK(stream.location.size >= sizeof system_info, "Bad system info stream");
-		CHECK(file.seek(stream.location.offset), "Bad system info offset");
-		CHECK(file.read(system_info), "Couldn't read system info");
+		CHECK(file.read_at(stream.location.offset, system_info), "Couldn't read system info");
 		check_extra_data(stream, sizeof system_info);
 
 		if (_summary)
@@ -721,7 +789,7 @@ namespace
 			std::cout << "\n\tCSDVersion: \"";
 			try
 			{
-				std::cout << ::to_ascii(::read_string(file, system_info.service_pack_name_offset));
+				std::cout << ::read_string(file, system_info.service_pack_name_offset);
 			}
 			catch (const BadCheck& e)
 			{
@@ -752,12 +820,11 @@ namespace
 			|| system_info.cpu_architecture == minidump::SystemInfo::X64, "Unsupported CPU architecture: " << system_info.cpu_architecture);
 	}
 
-	void Loader::load_system_memory_info(MinidumpData& dump, File& file, const minidump::Stream& stream)
+	void Loader::load_system_memory_info(MinidumpData& dump, const File& file, const minidump::Stream& stream)
 	{
 		minidump::SystemMemoryInfo1 system_memory_info;
 		CHECK(stream.location.size == sizeof system_memory_info, "Bad SystemMemoryInfoStream");
-		CHECK(file.seek(stream.location.offset), "Bad SystemMemoryInfoStream offset");
-		CHECK(file.read(system_memory_info), "Couldn't read SystemMemoryInfoStream");
+		CHECK(file.read_at(stream.location.offset, system_memory_info), "Couldn't read SystemMemoryInfoStream");
 		CHECK_EQ(system_memory_info.revision, minidump::SystemMemoryInfo1::Revision, "Unsupported SystemMemoryInfoStream revision");
 
 		if (_summary)
@@ -798,21 +865,22 @@ namespace
 		}
 	}
 
-	void Loader::load_thread_list(MinidumpData& dump, File& file, const minidump::Stream& stream)
+	void Loader::load_thread_list(MinidumpData& dump, const File& file, const minidump::Stream& stream)
 	{
 		CHECK(dump.threads.empty(), "Duplicate thread list");
 
 		minidump::ThreadListHeader header;
 		CHECK(stream.location.size >= sizeof header, "Bad thread list stream");
-		CHECK(file.seek(stream.location.offset), "Bad thread list offset");
-		CHECK(file.read(header), "Couldn't read thread list header");
+		CHECK(file.read_at(stream.location.offset, header), "Couldn't read thread list header");
 		CHECK_GE(header.entry_count, 0, "Bad thread list size");
 
-		std::vector<minidump::Thread> threads(header.entry_count);
-		CHECK(file.read(threads.data(), threads.size() * sizeof(minidump::Thread)), "Couldn't read thread list");
-		for (const auto& thread : threads)
+		const auto threads = file.view<minidump::Thread>(stream.location.offset + sizeof header, header.entry_count);
+		CHECK(threads, "Couldn't read thread list");
+		dump.threads.reserve(header.entry_count);
+		for (uint32_t i = 0; i < header.entry_count; ++i)
 		{
-			const auto index = &thread - &threads.front() + 1;
+			const auto& thread = threads[i];
+			const auto index = i + 1;
 
 			MinidumpData::Thread t;
 			t.id = thread.id;
@@ -820,33 +888,23 @@ namespace
 			t.stack_end = thread.stack.base + thread.stack.location.size;
 			t.context = ::load_thread_context(file, thread.context);
 
-			t.stack.reset(new uint8_t[t.stack_end - t.stack_base]);
-			if (thread.stack.location.offset)
-			{
-				CHECK(file.seek(thread.stack.location.offset), "Bad thread " << index << " stack offset");
-				CHECK(file.read(t.stack.get(), t.stack_end - t.stack_base), "Couldn't read thread " << index << " stack");
-			}
-			else
-			{
-				_loading_stacks.emplace_back(t.stack_base, t.stack_end, t.stack.get());
-			}
+			t.stack = MinidumpData::Stack(dump, t.stack_base, t.stack_end - t.stack_base, thread.stack.location.offset);
+			CHECK(!thread.stack.location.offset || (thread.stack.location.offset <= file.size()
+				&& thread.stack.location.size <= file.size() - thread.stack.location.offset), "Bad thread " << index << " stack");
 
 			dump.memory_usage.all_stacks += t.stack_base + t.stack_end;
 			dump.memory_usage.max_stack = std::max<uint64_t>(dump.memory_usage.max_stack, t.stack_base + t.stack_end);
-			if (dump.is_32bit && t.stack_end > End32)
-				dump.is_32bit = false;
+			if (_is_32bit && t.stack_end > End32)
+				_is_32bit = false;
 			dump.threads.emplace_back(std::move(t));
 		}
 	}
 
-	void Loader::load_thread_info_list(MinidumpData& dump, File& file, const minidump::Stream& stream)
+	void Loader::load_thread_info_list(MinidumpData& dump, const File& file, const minidump::Stream& stream)
 	{
-		CHECK(!dump.threads.empty(), "Loading thread info before thread list is not supported");
-
 		minidump::ThreadInfoListHeader header;
 		CHECK_GE(stream.location.size, sizeof header, "Bad thread info list stream");
-		CHECK(file.seek(stream.location.offset), "Bad thread info list offset");
-		CHECK(file.read(header), "Couldn't read thread info list header");
+		CHECK(file.read_at(stream.location.offset, header), "Couldn't read thread info list header");
 		CHECK_GE(header.header_size, sizeof header, "Bad thread info list header size");
 
 		minidump::ThreadInfo thread_info;
@@ -854,8 +912,7 @@ namespace
 		const auto base = stream.location.offset + header.header_size;
 		for (uint32_t i = 0; i < header.entry_count; ++i)
 		{
-			CHECK(file.seek(base + i * header.entry_size), "Bad thread info list");
-			CHECK(file.read(thread_info), "Couldn't read thread info entry");
+			CHECK(file.read_at(base + i * header.entry_size, thread_info), "Couldn't read thread info entry");
 			CHECK_EQ(thread_info.dump_flags & ~minidump::ThreadInfo::WritingThread, 0, "Unsupported thread flags");
 
 			const auto j = std::find_if(dump.threads.begin(), dump.threads.end(), [&thread_info](const auto& thread)
@@ -865,17 +922,16 @@ namespace
 			CHECK(j != dump.threads.end(), "Found thread info for unknown thread 0x" << ::to_hex(thread_info.thread_id));
 			j->start_address = thread_info.start_address;
 
-			if (dump.is_32bit && j->start_address >= End32)
-				dump.is_32bit = false;
+			if (_is_32bit && j->start_address >= End32)
+				_is_32bit = false;
 		}
 	}
 
-	void Loader::load_tokens(MinidumpData&, File& file, const minidump::Stream& stream)
+	void Loader::load_tokens(MinidumpData&, const File& file, const minidump::Stream& stream)
 	{
 		minidump::TokenInfoListHeader header;
 		CHECK_GE(stream.location.size, sizeof header, "Bad token info list stream");
-		CHECK(file.seek(stream.location.offset), "Bad token info list offset");
-		CHECK(file.read(header), "Couldn't read token info list header");
+		CHECK(file.read_at(stream.location.offset, header), "Couldn't read token info list header");
 		CHECK_EQ(header.total_size, stream.location.size, "Bad token stream header");
 		CHECK_GE(header.header_size, sizeof header, "Bad token stream header");
 
@@ -884,19 +940,17 @@ namespace
 		auto base = stream.location.offset + header.header_size;
 		for (uint32_t i = 0; i < header.entry_count; ++i)
 		{
-			CHECK(file.seek(base), "Bad token stream");
-			CHECK(file.read(token_info_header), "Couldn't read token entry header");
+			CHECK(file.read_at(base, token_info_header), "Couldn't read token entry header");
 		}
 	}
 
-	void Loader::load_unloaded_module_list(MinidumpData& dump, File& file, const minidump::Stream& stream)
+	void Loader::load_unloaded_module_list(MinidumpData& dump, const File& file, const minidump::Stream& stream)
 	{
 		CHECK(dump.unloaded_modules.empty(), "Duplicate unloaded module list");
 
 		minidump::UnloadedModuleListHeader header;
 		CHECK(stream.location.size >= sizeof header, "Bad unloaded module list stream");
-		CHECK(file.seek(stream.location.offset), "Bad unloaded module list offset");
-		CHECK(file.read(header), "Couldn't read unloaded module list header");
+		CHECK(file.read_at(stream.location.offset, header), "Couldn't read unloaded module list header");
 		CHECK_GE(header.header_size, sizeof header, "Bad unloaded module list header size");
 
 		minidump::UnloadedModule unloaded_module;
@@ -905,38 +959,36 @@ namespace
 		const auto base = stream.location.offset + header.header_size;
 		for (uint32_t i = 0; i < header.entry_count; ++i)
 		{
-			CHECK(file.seek(base + i * header.entry_size), "Bad unloaded module list");
-			CHECK(file.read(unloaded_module), "Couldn't unloaded module entry");
+			CHECK(file.read_at(base + i * header.entry_size, unloaded_module), "Couldn't unloaded module entry");
 
 			MinidumpData::UnloadedModule m;
-			m.file_path = ::to_ascii(::read_string(file, unloaded_module.name_offset));
+			m.file_path = ::read_string(file, unloaded_module.name_offset);
 			m.file_name = m.file_path.substr(m.file_path.find_last_of('\\') + 1);
 			m.timestamp = ::time_t_to_string(unloaded_module.time_date_stamp);
 			m.image_base = unloaded_module.image_base;
 			m.image_end = unloaded_module.image_base + unloaded_module.image_size;
-			if (dump.is_32bit && m.image_end > End32)
-				dump.is_32bit = false;
+			if (_is_32bit && m.image_end > End32)
+				_is_32bit = false;
 			dump.unloaded_modules.emplace_back(std::move(m));
 		}
 	}
 
-	void Loader::load_vm_counters(MinidumpData& dump, File& file, const minidump::Stream& stream)
+	void Loader::load_vm_counters(MinidumpData& dump, const File& file, const minidump::Stream& stream)
 	{
 		union
 		{
 			minidump::VmCounters1 vm_counters;
 			minidump::VmCounters2 vm_counters2;
 		};
-		CHECK(file.seek(stream.location.offset), "Bad ProcessVmCountersStream offset");
 		switch (stream.location.size)
 		{
 		case sizeof(minidump::VmCounters1):
-			CHECK(file.read(vm_counters), "Couldn't read ProcessVmCountersStream");
+			CHECK(file.read_at(stream.location.offset, vm_counters), "Couldn't read ProcessVmCountersStream");
 			CHECK_EQ(vm_counters.revision, minidump::VmCounters1::Revision, "Unsupported ProcessVmCountersStream revision " << vm_counters.revision);
 			CHECK(vm_counters.flags == 0, "Unsupported ProcessVmCountersStream flags 0x" << ::to_hex(vm_counters.flags));
 			break;
 		case sizeof(minidump::VmCounters2):
-			CHECK(file.read(vm_counters2), "Couldn't read ProcessVmCountersStream");
+			CHECK(file.read_at(stream.location.offset, vm_counters2), "Couldn't read ProcessVmCountersStream");
 			CHECK_EQ(vm_counters.revision, minidump::VmCounters2::Revision, "Unsupported ProcessVmCountersStream revision " << vm_counters.revision);
 			break;
 		default:
@@ -1000,9 +1052,31 @@ namespace
 	}
 }
 
-std::unique_ptr<MinidumpData> MinidumpData::load(const std::string& file_name, bool summary)
+std::unique_ptr<MinidumpData> MinidumpData::load(const std::string& file_name, bool summary, unsigned content, bool use_index)
 {
-	return Loader(summary).load(file_name);
+	if (!use_index || summary)
+		return Loader(summary, content).load(file_name);
+
+	// The index is made from a full load, so it serves any content.
+	const auto index_path = file_name + ".whyidx";
+	auto dump = ::read_dump_index(index_path, file_name);
+	if (dump)
+	{
+		::link_data(*dump);
+		return dump;
+	}
+	dump = Loader(false, Minidump::All).load(file_name);
+	::write_dump_index(index_path, file_name, *dump); // The dump is usable even if the index can't be written.
+	return dump;
+}
+
+const uint8_t* MinidumpData::Stack::data() const
+{
+	if (!_dump)
+		return nullptr;
+	return _offset
+		? _dump->file.view<uint8_t>(_offset, _size)
+		: _dump->memory_reader.view<uint8_t>(_base, _size);
 }
 
 std::string MinidumpData::Exception::to_string(bool is_32bit) const
@@ -1034,3 +1108,12 @@ std::string MinidumpData::Exception::to_string(bool is_32bit) const
 	}
 	return result;
 }
+
+std::string MinidumpData::module_name_by_index(size_t index) const
+{
+	if (index < modules.size())
+		return modules[index].file_name;
+	if (index != AddressIndex::None && index - modules.size() < unloaded_modules.size())
+		return "<Unloaded_" + unloaded_modules[index - modules.size()].file_name + ">";
+	return {};
+}
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "address_index.h"
+#include "file.h"
+#include "memory_reader.h"
+#include "pe.h"
 #include <map>
 #include <memory>
 #include <string>
@@ -26,18 +30,55 @@ public:
 		std::string timestamp;
 		std::string pdb_path;
 		std::string pdb_name;
+		std::string pdb_id;          // PDB GUID and age as used in Breakpad symbol directories.
 		uint64_t    image_base = 0;
 		uint64_t    image_end = 0;
 	};
 
-	union Context
+	struct Context
 	{
+		// Indices of x64 registers.
+		enum : size_t
+		{
+			Rsp = 4,
+			Rbp = 5,
+		};
+
+		// Lower halves of RIP, RSP and RBP for x64 contexts (which are WoW64 ones in 32-bit dumps).
 		struct
 		{
-			uint32_t eip;
-			uint32_t esp;
-			uint32_t ebp;
+			uint32_t eip = 0;
+			uint32_t esp = 0;
+			uint32_t ebp = 0;
 		} x86;
+
+		// Zero for x86 contexts.
+		struct
+		{
+			uint64_t rip = 0;
+			uint64_t registers[16] = {}; // RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8-R15 (in unwind code order).
+		} x64;
+	};
+
+	// Thread stack memory which is located in the dump file only when it is accessed.
+	class Stack
+	{
+	public:
+		Stack() = default;
+		Stack(const MinidumpData& dump, uint64_t base, uint64_t size, uint64_t offset)
+			: _dump(&dump), _base(base), _size(size), _offset(offset) {}
+
+		// Returns the stack memory or nullptr if it isn't present in the dump.
+		const uint8_t* data() const;
+
+		// Returns the offset of the stack memory in the dump file, or zero if it is in memory lists.
+		uint64_t file_offset() const { return _offset; }
+
+	private:
+		const MinidumpData* _dump = nullptr;
+		uint64_t _base = 0;
+		uint64_t _size = 0;
+		uint64_t _offset = 0; // Zero if the stack memory should be looked up in memory lists.
 	};
 
 	struct Thread
@@ -47,7 +88,7 @@ public:
 		uint64_t stack_end = 0;
 		uint64_t start_address = 0;
 		std::unique_ptr<Context> context;
-		std::unique_ptr<uint8_t[]> stack;
+		Stack stack;
 	};
 
 	struct Exception
@@ -113,6 +154,7 @@ public:
 		std::string object_name;
 	};
 
+	File file;
 	time_t timestamp = 0;
 	std::vector<Module> modules;
 	std::vector<Thread> threads;
@@ -120,10 +162,17 @@ public:
 	bool is_32bit = true;
 	std::unique_ptr<Exception> exception;
 	std::map<uint64_t, MemoryInfo> memory;
+	MemoryReader memory_reader;
 	std::map<uint64_t, MemoryRegion> memory_regions;
 	std::vector<UnloadedModule> unloaded_modules;
 	std::vector<Handle> handles;
+	AddressIndex module_index; // Module indices, then unloaded module indices offset by the module count.
+	ImageTables images;        // Tables of loaded module images in captured memory.
+
+	// Returns the file name for a module_index value, or an empty string.
+	std::string module_name_by_index(size_t index) const;
 
-	//
-	static std::unique_ptr<MinidumpData> load(const std::string& file_name, bool summary);
+	// Loads the specified Minidump::Content; summary mode loads everything.
+	// With 'use_index', the decoded data is read from or saved to the sidecar index next to the dump.
+	static std::unique_ptr<MinidumpData> load(const std::string& file_name, bool summary, unsigned content, bool use_index = false);
 };
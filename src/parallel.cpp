@@ -0,0 +1,143 @@
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+	// Set in threads doing parallel work, so that nested parallel work runs sequentially instead of oversubscribing.
+	thread_local bool is_worker_thread = false;
+
+	class WorkerScope
+	{
+	public:
+		WorkerScope() : _was_worker_thread(is_worker_thread) { is_worker_thread = true; }
+		~WorkerScope() { is_worker_thread = _was_worker_thread; }
+
+	private:
+		const bool _was_worker_thread;
+	};
+}
+
+size_t TaskGraph::add(std::function<void()>&& function)
+{
+	_tasks.emplace_back();
+	_tasks.back().function = std::move(function);
+	return _tasks.size() - 1;
+}
+
+void TaskGraph::depend(size_t task, size_t dependency)
+{
+	assert(task < _tasks.size() && dependency < _tasks.size() && task != dependency);
+	_tasks[dependency].dependents.emplace_back(task);
+	++_tasks[task].dependencies;
+}
+
+void TaskGraph::run(unsigned threads)
+{
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<size_t> ready;
+	size_t running = 0;
+	std::exception_ptr error;
+
+	for (size_t i = 0; i < _tasks.size(); ++i)
+		if (!_tasks[i].dependencies)
+			ready.emplace_back(i);
+
+	const auto worker = [this, &mutex, &condition, &ready, &running, &error]
+	{
+		WorkerScope worker_scope;
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;)
+		{
+			condition.wait(lock, [&ready, &running] { return !ready.empty() || !running; });
+			if (ready.empty())
+				return;
+			auto& task = _tasks[ready.front()];
+			ready.pop_front();
+			++running;
+			lock.unlock();
+			std::exception_ptr task_error;
+			try
+			{
+				task.function();
+			}
+			catch (...)
+			{
+				task_error = std::current_exception();
+			}
+			lock.lock();
+			--running;
+			if (task_error && !error)
+				error = task_error;
+			if (error)
+				ready.clear();
+			else
+				for (const auto dependent : task.dependents)
+					if (!--_tasks[dependent].dependencies)
+						ready.emplace_back(dependent);
+			condition.notify_all();
+		}
+	};
+
+	if (!threads)
+		threads = ::worker_count();
+	std::vector<std::thread> workers;
+	for (size_t i = 1; i < std::min<size_t>(threads, _tasks.size()); ++i)
+		workers.emplace_back(worker);
+	worker();
+	for (auto& thread : workers)
+		thread.join();
+
+	_tasks.clear();
+	if (error)
+		std::rethrow_exception(error);
+}
+
+void parallel_for(size_t count, const std::function<void(size_t)>& function)
+{
+	std::atomic<size_t> next_index{ 0 };
+	std::atomic<bool> failed{ false };
+	std::mutex mutex;
+	std::exception_ptr error;
+
+	const auto worker = [count, &function, &next_index, &failed, &mutex, &error]
+	{
+		WorkerScope worker_scope;
+		for (auto index = next_index++; index < count && !failed; index = next_index++)
+		{
+			try
+			{
+				function(index);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (!error)
+					error = std::current_exception();
+				failed = true;
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (size_t i = 1; i < std::min<size_t>(::worker_count(), count); ++i)
+		workers.emplace_back(worker);
+	worker();
+	for (auto& thread : workers)
+		thread.join();
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+unsigned worker_count()
+{
+	return is_worker_thread ? 1 : std::max(std::thread::hardware_concurrency(), 1u);
+}
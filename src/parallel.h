@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+// Set of tasks with dependencies between them.
+class TaskGraph
+{
+public:
+
+	// Adds a task and returns its index.
+	size_t add(std::function<void()>&& function);
+
+	// Makes a task wait for another task to finish.
+	void depend(size_t task, size_t dependency);
+
+	// Runs all tasks using up to the specified number of threads (including the calling one),
+	// zero meaning the number of hardware threads. The first exception thrown by a task is rethrown
+	// after the running tasks have finished, and the tasks that haven't started are abandoned.
+	void run(unsigned threads = 0);
+
+private:
+
+	struct Task
+	{
+		std::function<void()> function;
+		std::vector<size_t> dependents;
+		size_t dependencies = 0;
+	};
+
+	std::vector<Task> _tasks;
+};
+
+// Calls the function for each index in [0, count) using all hardware threads,
+// or only the calling thread if it is already doing parallel work.
+// Indices are handed out one by one, so uneven work is balanced between threads.
+// The first exception thrown by the function is rethrown after all threads have finished.
+void parallel_for(size_t count, const std::function<void(size_t)>& function);
+
+// Returns the number of threads used for parallel work, which is one inside parallel work.
+unsigned worker_count();
@@ -1,4 +1,6 @@
 #include "parser.h"
+#include <algorithm>
+#include <stdexcept>
 
 namespace
 {
@@ -45,7 +47,10 @@ namespace parser
 			const auto command = commands.find(name);
 			if (command == commands.end())
 				throw std::runtime_error("Unknown command '" + name + "'");
-			if (arguments.size() != command->second->arguments.size())
+			const auto& expected_arguments = command->second->arguments;
+			const auto required_arguments = std::find_if(expected_arguments.begin(), expected_arguments.end(),
+				[](const std::string& argument) { return argument.front() == '['; }) - expected_arguments.begin();
+			if (arguments.size() < static_cast<size_t>(required_arguments) || arguments.size() > expected_arguments.size())
 				throw std::runtime_error("Bad number of arguments for command '" + name + "'");
 			result.emplace_back(command->second, std::move(arguments));
 		}
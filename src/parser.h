@@ -14,9 +14,10 @@ namespace parser
 			std::string primary;
 			std::string alias;
 		} names;
-		std::vector<std::string> arguments;
+		std::vector<std::string> arguments; // Trailing arguments in square brackets are optional.
 		std::string description;
 		std::function<void(const std::vector<std::string>&)> handler;
+		unsigned requirements = 0; // Application-defined flags.
 	};
 
 	using ParsedCommand = std::pair<const Command*, std::vector<std::string>>;
@@ -0,0 +1,259 @@
+#include "pdb.h"
+#include "check.h"
+#include "utils.h"
+#include <algorithm>
+#include <cstring>
+
+#pragma pack(push, 1)
+
+namespace
+{
+	namespace msf
+	{
+		struct SuperBlock
+		{
+			char     signature[32];
+			uint32_t block_size;
+			uint32_t free_block_map_block;
+			uint32_t block_count;
+			uint32_t directory_size;
+			uint32_t reserved;
+			uint32_t directory_map_block; // Block containing block numbers of the stream directory.
+
+			static constexpr char Signature[32] = "Microsoft C/C++ MSF 7.00\r\n\x1a" "DS\0\0";
+		};
+
+		constexpr char SuperBlock::Signature[32];
+
+		constexpr uint32_t NilStreamSize = UINT32_MAX;
+	}
+
+	namespace pdb
+	{
+		enum : uint32_t
+		{
+			InfoStream = 1,
+			DbiStream = 3,
+		};
+
+		struct InfoHeader
+		{
+			uint32_t version;
+			uint32_t signature;
+			uint32_t age;
+			uint8_t  guid[16];
+		};
+
+		struct DbiHeader
+		{
+			int32_t  version_signature;
+			uint32_t version;
+			uint32_t age;
+			uint16_t global_stream;
+			uint16_t build_number;
+			uint16_t public_stream;
+			uint16_t pdb_dll_version;
+			uint16_t symbol_stream;
+			uint16_t pdb_dll_rebuild;
+			int32_t  module_info_size;
+			int32_t  section_contribution_size;
+			int32_t  section_map_size;
+			int32_t  source_info_size;
+			int32_t  type_server_map_size;
+			uint32_t mfc_type_server_index;
+			int32_t  debug_header_size;
+			int32_t  ec_info_size;
+			uint16_t flags;
+			uint16_t machine;
+			uint32_t padding;
+		};
+
+		static_assert(sizeof(DbiHeader) == 64, "Bad DBI header size");
+
+		// Index of the section header stream in the DBI optional debug header.
+		constexpr size_t SectionHeaderStreamIndex = 5;
+
+		struct SectionHeader
+		{
+			char     name[8];
+			uint32_t virtual_size;
+			uint32_t virtual_address;
+			uint32_t raw_data_size;
+			uint32_t raw_data_offset;
+			uint32_t relocations_offset;
+			uint32_t line_numbers_offset;
+			uint16_t relocation_count;
+			uint16_t line_number_count;
+			uint32_t characteristics;
+		};
+
+		struct PublicsHeader
+		{
+			uint32_t hash_size;
+			uint32_t address_map_size;
+			uint32_t thunk_count;
+			uint32_t thunk_size;
+			uint16_t thunk_table_section;
+			uint16_t padding;
+			uint32_t thunk_table_offset;
+			uint32_t section_count;
+		};
+
+		struct SymbolHeader
+		{
+			uint16_t size; // Record size excluding this field.
+			uint16_t kind;
+		};
+
+		struct Public32
+		{
+			SymbolHeader header;
+			uint32_t     flags;
+			uint32_t     offset;
+			uint16_t     segment;
+			// Followed by a null-terminated name.
+
+			static constexpr uint16_t Kind = 0x110e; // S_PUB32.
+			static constexpr uint32_t Code = 0x1;
+			static constexpr uint32_t Function = 0x2;
+		};
+
+		static_assert(sizeof(Public32) == 14, "Bad public symbol record size");
+	}
+}
+
+#pragma pack(pop)
+
+Pdb::Pdb(File&& file)
+	: _file(std::move(file))
+{
+	const auto super_block = _file.view<msf::SuperBlock>(0);
+	CHECK(super_block, "Bad PDB file");
+	CHECK(std::equal(std::begin(super_block->signature), std::end(super_block->signature), msf::SuperBlock::Signature), "Bad PDB signature");
+	_block_size = super_block->block_size;
+	CHECK(_block_size == 512 || _block_size == 1024 || _block_size == 2048 || _block_size == 4096, "Bad PDB block size");
+	CHECK_LE(uint64_t{super_block->block_count} * _block_size, _file.size(), "Bad PDB block count");
+
+	// The directory lists stream sizes followed by block numbers of each stream.
+	const auto directory_block_count = (super_block->directory_size + _block_size - 1) / _block_size;
+	const auto directory_map = _file.view<uint32_t>(uint64_t{super_block->directory_map_block} * _block_size, directory_block_count);
+	CHECK(directory_map, "Bad PDB directory map");
+	std::vector<uint32_t> directory;
+	directory.reserve(directory_block_count * (_block_size / sizeof(uint32_t)));
+	for (uint32_t i = 0; i < directory_block_count; ++i)
+	{
+		const auto block = _file.view<uint32_t>(uint64_t{directory_map[i]} * _block_size, _block_size / sizeof(uint32_t));
+		CHECK(block, "Bad PDB directory block");
+		directory.insert(directory.end(), block, block + _block_size / sizeof(uint32_t));
+	}
+	directory.resize(super_block->directory_size / sizeof(uint32_t));
+	CHECK(!directory.empty() && directory.size() > directory[0], "Bad PDB directory");
+
+	const auto stream_count = directory[0];
+	_stream_sizes.assign(directory.begin() + 1, directory.begin() + 1 + stream_count);
+	_stream_blocks.reserve(stream_count);
+	size_t block_index = 0;
+	for (auto& size : _stream_sizes)
+	{
+		if (size == msf::NilStreamSize)
+			size = 0;
+		_stream_blocks.emplace_back(block_index);
+		block_index += (size + _block_size - 1) / _block_size;
+	}
+	CHECK_LE(1 + stream_count + block_index, directory.size(), "Bad PDB directory size");
+	_blocks.assign(directory.begin() + 1 + stream_count, directory.begin() + 1 + stream_count + block_index);
+
+	pdb::InfoHeader info;
+	CHECK(read(pdb::InfoStream, 0, info), "Couldn't read PDB information");
+	::memcpy(_guid, info.guid, sizeof _guid);
+
+	pdb::DbiHeader dbi;
+	CHECK(read(pdb::DbiStream, 0, dbi), "Couldn't read PDB DBI header");
+	CHECK_EQ(dbi.version_signature, -1, "Unsupported PDB DBI version");
+	_age = dbi.age; // CodeView records refer to the DBI age which may differ from the information stream age.
+	_public_stream = dbi.public_stream;
+	_symbol_stream = dbi.symbol_stream;
+
+	CHECK(dbi.module_info_size >= 0 && dbi.section_contribution_size >= 0 && dbi.section_map_size >= 0
+		&& dbi.source_info_size >= 0 && dbi.type_server_map_size >= 0 && dbi.ec_info_size >= 0, "Bad PDB DBI substream size");
+	const auto debug_header_offset = sizeof dbi + uint64_t{static_cast<uint32_t>(dbi.module_info_size)} + dbi.section_contribution_size
+		+ dbi.section_map_size + dbi.source_info_size + dbi.type_server_map_size + dbi.ec_info_size;
+	uint16_t section_header_stream = UINT16_MAX;
+	if (dbi.debug_header_size >= static_cast<int32_t>((pdb::SectionHeaderStreamIndex + 1) * sizeof(uint16_t)))
+		read(pdb::DbiStream, debug_header_offset + pdb::SectionHeaderStreamIndex * sizeof(uint16_t), section_header_stream);
+	CHECK(section_header_stream < _stream_sizes.size(), "Missing PDB section headers");
+	const auto section_headers = read_stream(section_header_stream);
+	for (size_t offset = 0; offset + sizeof(pdb::SectionHeader) <= section_headers.size(); offset += sizeof(pdb::SectionHeader))
+	{
+		pdb::SectionHeader section;
+		::memcpy(&section, section_headers.data() + offset, sizeof section);
+		_section_rvas.emplace_back(section.virtual_address);
+	}
+}
+
+std::string Pdb::id() const
+{
+	return ::to_pdb_id(_guid, _age);
+}
+
+std::vector<std::pair<uint32_t, std::string>> Pdb::public_symbols() const
+{
+	CHECK(_public_stream < _stream_sizes.size() && _symbol_stream < _stream_sizes.size(), "Missing PDB public symbols");
+
+	// The address map lists offsets of public symbol records sorted by address, so neither the hash table
+	// nor records of other kinds in the symbol record stream need to be read.
+	pdb::PublicsHeader header;
+	CHECK(read(_public_stream, 0, header), "Couldn't read PDB public symbol header");
+	std::vector<uint32_t> address_map(header.address_map_size / sizeof(uint32_t));
+	CHECK(read(_public_stream, sizeof header + uint64_t{header.hash_size}, address_map.data(), address_map.size() * sizeof(uint32_t)),
+		"Couldn't read PDB public symbol address map");
+
+	std::vector<std::pair<uint32_t, std::string>> symbols;
+	symbols.reserve(address_map.size());
+	std::vector<char> record;
+	for (const auto offset : address_map)
+	{
+		pdb::Public32 symbol;
+		if (!read(_symbol_stream, offset, symbol) || symbol.header.kind != pdb::Public32::Kind)
+			continue;
+		if (!(symbol.flags & (pdb::Public32::Code | pdb::Public32::Function)))
+			continue;
+		if (symbol.segment == 0 || symbol.segment > _section_rvas.size())
+			continue;
+		if (symbol.header.size + sizeof symbol.header.size < sizeof symbol)
+			continue;
+		const auto name_size = symbol.header.size + sizeof symbol.header.size - sizeof symbol;
+		record.resize(name_size);
+		CHECK(read(_symbol_stream, offset + sizeof symbol, record.data(), record.size()), "Couldn't read PDB public symbol");
+		symbols.emplace_back(_section_rvas[symbol.segment - 1] + symbol.offset, std::string(record.data(), ::strnlen(record.data(), record.size())));
+	}
+	return symbols;
+}
+
+bool Pdb::read(uint32_t stream, uint64_t offset, void* buffer, size_t size) const
+{
+	if (stream >= _stream_sizes.size() || offset > _stream_sizes[stream] || size > _stream_sizes[stream] - offset)
+		return false;
+	auto output = static_cast<uint8_t*>(buffer);
+	while (size > 0)
+	{
+		const auto block = _blocks[_stream_blocks[stream] + offset / _block_size];
+		const auto block_offset = offset % _block_size;
+		const auto part_size = std::min<uint64_t>(size, _block_size - block_offset);
+		const auto data = _file.view(uint64_t{block} * _block_size + block_offset, part_size);
+		if (!data)
+			return false;
+		::memcpy(output, data, part_size);
+		output += part_size;
+		offset += part_size;
+		size -= part_size;
+	}
+	return true;
+}
+
+std::vector<uint8_t> Pdb::read_stream(uint32_t stream) const
+{
+	std::vector<uint8_t> data(stream < _stream_sizes.size() ? _stream_sizes[stream] : 0);
+	CHECK(read(stream, 0, data.data(), data.size()), "Couldn't read PDB stream " << stream);
+	return data;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "file.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+// Program database (MSF 7.0 container) reader.
+// Streams are read block by block from the mapped file, so only the blocks actually used are loaded.
+class Pdb
+{
+public:
+
+	// Throws BadCheck if the file isn't a valid PDB.
+	explicit Pdb(File&&);
+
+	// Returns the PDB GUID and age in the same form as MinidumpData::Module::pdb_id.
+	std::string id() const;
+
+	// Returns code public symbols as relative virtual addresses and decorated names.
+	std::vector<std::pair<uint32_t, std::string>> public_symbols() const;
+
+private:
+
+	// Copies stream data to the buffer, returns false if it is outside of the stream.
+	bool read(uint32_t stream, uint64_t offset, void* buffer, size_t size) const;
+
+	std::vector<uint8_t> read_stream(uint32_t stream) const;
+
+	template <typename T>
+	bool read(uint32_t stream, uint64_t offset, T& value) const { return read(stream, offset, &value, sizeof value); }
+
+private:
+	File _file;
+	uint32_t _block_size = 0;
+	std::vector<uint32_t> _stream_sizes;
+	std::vector<size_t> _stream_blocks;   // Index of the first block of each stream in _blocks.
+	std::vector<uint32_t> _blocks;        // Stream block numbers.
+	std::vector<uint32_t> _section_rvas;  // Section virtual addresses, to convert segment offsets to RVAs.
+	uint32_t _public_stream = 0;
+	uint32_t _symbol_stream = 0;
+	uint8_t _guid[16] = {};
+	uint32_t _age = 0;
+};
@@ -0,0 +1,269 @@
+#include "pe.h"
+#include "memory_reader.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+#pragma pack(push, 1)
+
+namespace
+{
+	namespace pe
+	{
+		struct DosHeader
+		{
+			uint16_t signature;
+			uint8_t  reserved[58];
+			uint32_t nt_headers_offset;
+
+			static constexpr uint16_t Signature = 0x5a4d; // "MZ".
+		};
+
+		struct NtHeaders
+		{
+			uint32_t signature;
+			uint16_t machine;
+			uint16_t section_count;
+			uint32_t timestamp;
+			uint32_t symbol_table_offset;
+			uint32_t symbol_count;
+			uint16_t optional_header_size;
+			uint16_t characteristics;
+			uint16_t optional_header_magic;
+
+			static constexpr uint32_t Signature = 0x00004550; // "PE\0\0".
+			static constexpr uint16_t Magic32 = 0x10b;
+			static constexpr uint16_t Magic64 = 0x20b;
+		};
+
+		// Offsets of the data directory count in 32-bit and 64-bit optional headers.
+		constexpr uint32_t DataDirectoryCountOffset32 = 92;
+		constexpr uint32_t DataDirectoryCountOffset64 = 108;
+
+		// Data directory entry indices.
+		constexpr uint32_t ExportDirectoryIndex = 0;
+		constexpr uint32_t ExceptionDirectoryIndex = 3;
+
+		struct DataDirectory
+		{
+			uint32_t rva;
+			uint32_t size;
+		};
+
+		struct SectionHeader
+		{
+			char     name[8];
+			uint32_t virtual_size;
+			uint32_t virtual_address;
+			uint32_t raw_data_size;
+			uint32_t raw_data_offset;
+			uint32_t relocations_offset;
+			uint32_t line_numbers_offset;
+			uint16_t relocation_count;
+			uint16_t line_number_count;
+			uint32_t characteristics;
+
+			static constexpr uint32_t Code = 0x00000020;    // (IMAGE_SCN_CNT_CODE).
+			static constexpr uint32_t Execute = 0x20000000; // (IMAGE_SCN_MEM_EXECUTE).
+		};
+
+		// Offset of the optional header in NT headers.
+		constexpr uint32_t OptionalHeaderOffset = 24;
+
+		struct ExportDirectory
+		{
+			uint32_t characteristics;
+			uint32_t timestamp;
+			uint16_t major_version;
+			uint16_t minor_version;
+			uint32_t name;
+			uint32_t ordinal_base;
+			uint32_t function_count;
+			uint32_t name_count;
+			uint32_t functions;     // RVA of function RVAs.
+			uint32_t names;         // RVA of name RVAs.
+			uint32_t name_ordinals; // RVA of 16-bit function indices for names.
+		};
+	}
+}
+
+#pragma pack(pop)
+
+namespace
+{
+	// Reads NT headers of a PE image, returns false if they aren't present.
+	bool read_nt_headers(const MemoryReader& memory_reader, uint64_t image_base, uint64_t& nt_headers_address, pe::NtHeaders& nt_headers)
+	{
+		pe::DosHeader dos_header;
+		if (!memory_reader.read(image_base, dos_header) || dos_header.signature != pe::DosHeader::Signature)
+			return false;
+		nt_headers_address = image_base + dos_header.nt_headers_offset;
+		return memory_reader.read(nt_headers_address, nt_headers) && nt_headers.signature == pe::NtHeaders::Signature;
+	}
+
+	// Reads the data directory entry of a PE image, returns false if the image or the entry isn't present.
+	bool read_data_directory(const MemoryReader& memory_reader, uint64_t image_base, uint32_t index, pe::DataDirectory& data_directory)
+	{
+		uint64_t nt_headers_address = 0;
+		pe::NtHeaders nt_headers;
+		if (!::read_nt_headers(memory_reader, image_base, nt_headers_address, nt_headers))
+			return false;
+		uint32_t count_offset = 0;
+		if (nt_headers.optional_header_magic == pe::NtHeaders::Magic32)
+			count_offset = pe::DataDirectoryCountOffset32;
+		else if (nt_headers.optional_header_magic == pe::NtHeaders::Magic64)
+			count_offset = pe::DataDirectoryCountOffset64;
+		else
+			return false;
+		const auto optional_header_address = nt_headers_address + offsetof(pe::NtHeaders, optional_header_magic);
+		const auto entry_offset = count_offset + sizeof(uint32_t) + index * sizeof data_directory;
+		uint32_t directory_count = 0;
+		return entry_offset + sizeof data_directory <= nt_headers.optional_header_size
+			&& memory_reader.read(optional_header_address + count_offset, directory_count) && directory_count > index
+			&& memory_reader.read(optional_header_address + entry_offset, data_directory)
+			&& data_directory.rva && data_directory.size;
+	}
+}
+
+std::vector<std::pair<uint32_t, std::string>> read_pe_exports(const MemoryReader& memory_reader, uint64_t image_base, uint64_t image_size)
+{
+	pe::DataDirectory export_data;
+	pe::ExportDirectory directory;
+	if (!::read_data_directory(memory_reader, image_base, pe::ExportDirectoryIndex, export_data) || export_data.size < sizeof directory
+		|| uint64_t{export_data.rva} + export_data.size > image_size
+		|| !memory_reader.read(image_base + export_data.rva, directory))
+		return {};
+
+	// The sizes come from captured memory, so arrays that don't fit in the image are rejected before they are allocated.
+	const auto read_array = [&memory_reader, image_base, image_size](uint32_t rva, uint32_t count, auto& array)
+	{
+		using Element = typename std::decay_t<decltype(array)>::value_type;
+		if (uint64_t{rva} + uint64_t{count} * sizeof(Element) > image_size)
+			return false;
+		array.resize(count);
+		return !count || memory_reader.read(image_base + rva, array.data(), count * sizeof(Element));
+	};
+	const auto string = [&memory_reader, image_base, image_size](uint32_t rva) -> std::string
+	{
+		if (rva >= image_size)
+			return {};
+		const auto max_size = std::min<uint64_t>(256, image_size - rva);
+		if (const auto data = memory_reader.view<char>(image_base + rva, max_size))
+			return std::string(data, ::strnlen(data, max_size));
+		std::string result;
+		for (char c; result.size() < max_size && memory_reader.read(image_base + rva + result.size(), c) && c; )
+			result.push_back(c);
+		return result;
+	};
+
+	std::vector<uint32_t> functions;
+	if (!read_array(directory.functions, directory.function_count, functions))
+		return {};
+	std::vector<std::string> names(functions.size());
+	std::vector<uint32_t> name_rvas;
+	std::vector<uint16_t> name_ordinals;
+	if (read_array(directory.names, directory.name_count, name_rvas) && read_array(directory.name_ordinals, directory.name_count, name_ordinals))
+	{
+		for (uint32_t i = 0; i < directory.name_count; ++i)
+		{
+			const auto index = name_ordinals[i];
+			if (index < names.size() && names[index].empty())
+				names[index] = string(name_rvas[i]);
+		}
+	}
+
+	std::vector<std::pair<uint32_t, std::string>> exports;
+	exports.reserve(functions.size());
+	for (uint32_t i = 0; i < functions.size(); ++i)
+	{
+		const auto rva = functions[i];
+		if (!rva || (rva >= export_data.rva && rva - export_data.rva < export_data.size))
+			continue; // Unused entry or a forwarder string.
+		exports.emplace_back(rva, !names[i].empty() ? std::move(names[i]) : "Ordinal" + std::to_string(directory.ordinal_base + i));
+	}
+	return exports;
+}
+
+bool read_pe_code_ranges(const MemoryReader& memory_reader, uint64_t image_base, std::vector<std::pair<uint32_t, uint32_t>>& ranges)
+{
+	uint64_t nt_headers_address = 0;
+	pe::NtHeaders nt_headers;
+	if (!::read_nt_headers(memory_reader, image_base, nt_headers_address, nt_headers))
+		return false;
+	std::vector<pe::SectionHeader> sections(nt_headers.section_count);
+	if (!memory_reader.read(nt_headers_address + pe::OptionalHeaderOffset + nt_headers.optional_header_size, sections.data(), sections.size() * sizeof(pe::SectionHeader)))
+		return false;
+	ranges.clear();
+	for (const auto& section : sections)
+		if (section.characteristics & (pe::SectionHeader::Code | pe::SectionHeader::Execute))
+			ranges.emplace_back(section.virtual_address, section.virtual_address + section.virtual_size);
+	std::sort(ranges.begin(), ranges.end());
+	return !ranges.empty(); // Zeroed headers are treated as missing ones.
+}
+
+std::vector<RuntimeFunction> read_pe_runtime_functions(const MemoryReader& memory_reader, uint64_t image_base, uint64_t image_size)
+{
+	pe::DataDirectory exception_data;
+	if (!::read_data_directory(memory_reader, image_base, pe::ExceptionDirectoryIndex, exception_data)
+		|| uint64_t{exception_data.rva} + exception_data.size > image_size)
+		return {};
+	std::vector<RuntimeFunction> functions(exception_data.size / sizeof(RuntimeFunction));
+	if (!memory_reader.read(image_base + exception_data.rva, functions.data(), functions.size() * sizeof(RuntimeFunction)))
+		return {};
+	// The table is sorted by the linker, but a broken table mustn't break lookups.
+	if (!std::is_sorted(functions.begin(), functions.end(), [](const auto& a, const auto& b) { return a.begin < b.begin; }))
+		std::sort(functions.begin(), functions.end(), [](const auto& a, const auto& b) { return a.begin < b.begin; });
+	return functions;
+}
+
+ImageTables::ImageTables(const MemoryReader& memory_reader, std::vector<std::pair<uint64_t, uint64_t>>&& images)
+	: _memory_reader(&memory_reader)
+	, _images(std::move(images))
+	, _entries(std::make_unique<Entry[]>(_images.size()))
+{
+}
+
+const SymbolTable* ImageTables::exports(size_t module_index) const
+{
+	if (module_index >= _images.size())
+		return nullptr;
+	auto& entry = _entries[module_index];
+	std::call_once(entry.exports_once, [this, &entry, module_index]
+	{
+		auto exports = ::read_pe_exports(*_memory_reader, _images[module_index].first, _images[module_index].second - _images[module_index].first);
+		if (!exports.empty())
+			entry.exports = std::make_unique<SymbolTable>(SymbolTable::compile(std::move(exports)));
+	});
+	return entry.exports.get();
+}
+
+bool ImageTables::is_code(size_t module_index, uint32_t rva) const
+{
+	if (module_index >= _images.size())
+		return false;
+	auto& entry = _entries[module_index];
+	std::call_once(entry.code_ranges_once, [this, &entry, module_index]
+	{
+		entry.has_code_ranges = ::read_pe_code_ranges(*_memory_reader, _images[module_index].first, entry.code_ranges);
+	});
+	if (!entry.has_code_ranges)
+		return true;
+	const auto& ranges = entry.code_ranges;
+	const auto i = std::upper_bound(ranges.begin(), ranges.end(), std::make_pair(rva, UINT32_MAX));
+	return i != ranges.begin() && rva < i[-1].second;
+}
+
+const RuntimeFunction* ImageTables::find_runtime_function(size_t module_index, uint32_t rva) const
+{
+	if (module_index >= _images.size())
+		return nullptr;
+	auto& entry = _entries[module_index];
+	std::call_once(entry.runtime_functions_once, [this, &entry, module_index]
+	{
+		entry.runtime_functions = ::read_pe_runtime_functions(*_memory_reader, _images[module_index].first, _images[module_index].second - _images[module_index].first);
+	});
+	const auto& functions = entry.runtime_functions;
+	const auto i = std::upper_bound(functions.begin(), functions.end(), rva, [](uint32_t rva, const auto& function) { return rva < function.begin; });
+	return i != functions.begin() && rva < i[-1].end ? &i[-1] : nullptr;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "symbols.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class MemoryReader;
+
+// Reads exported functions from a PE image in captured memory.
+// Returns relative virtual addresses and names, or nothing if the headers aren't captured
+// or the export tables don't fit in the image.
+std::vector<std::pair<uint32_t, std::string>> read_pe_exports(const MemoryReader&, uint64_t image_base, uint64_t image_size);
+
+// Reads RVA ranges of executable sections of a PE image in captured memory, returns false if they aren't captured.
+bool read_pe_code_ranges(const MemoryReader&, uint64_t image_base, std::vector<std::pair<uint32_t, uint32_t>>& ranges);
+
+// Function table entry of an x64 image (RUNTIME_FUNCTION).
+struct RuntimeFunction
+{
+	uint32_t begin;       // Function start RVA.
+	uint32_t end;         // Function end RVA.
+	uint32_t unwind_info; // RVA of the unwind information.
+};
+
+// Reads the sorted function table of an x64 PE image in captured memory, or nothing if it doesn't fit in the image.
+std::vector<RuntimeFunction> read_pe_runtime_functions(const MemoryReader&, uint64_t image_base, uint64_t image_size);
+
+// Tables read from PE images of loaded modules, each built on first use; safe to use concurrently.
+class ImageTables
+{
+public:
+
+	ImageTables() = default;
+	ImageTables(const MemoryReader&, std::vector<std::pair<uint64_t, uint64_t>>&& images); // Image bases and ends.
+
+	// Returns the export table of the module, or nullptr if the module has no exports in captured memory.
+	const SymbolTable* exports(size_t module_index) const;
+
+	// Returns true if the RVA is in an executable section of the module or if its section headers aren't captured.
+	bool is_code(size_t module_index, uint32_t rva) const;
+
+	// Returns the x64 function table entry containing the RVA, or nullptr for leaf functions.
+	const RuntimeFunction* find_runtime_function(size_t module_index, uint32_t rva) const;
+
+private:
+
+	struct Entry
+	{
+		std::once_flag exports_once;
+		std::unique_ptr<SymbolTable> exports;
+		std::once_flag runtime_functions_once;
+		std::vector<RuntimeFunction> runtime_functions;
+		std::once_flag code_ranges_once;
+		bool has_code_ranges = false;
+		std::vector<std::pair<uint32_t, uint32_t>> code_ranges;
+	};
+
+private:
+	const MemoryReader* _memory_reader = nullptr;
+	std::vector<std::pair<uint64_t, uint64_t>> _images;
+	std::unique_ptr<Entry[]> _entries;
+};
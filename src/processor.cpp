@@ -1,12 +1,15 @@
 #include "processor.h"
 #include "minidump.h"
 #include "parser.h"
+#include "scan.h"
 #include "utils.h"
 #include <chrono>
 #include <iostream>
 
-Processor::Processor(std::unique_ptr<Minidump>&& dump)
-	: _dump(std::move(dump))
+Processor::Processor(std::ostream& output, std::ostream& errors, std::unique_ptr<Minidump>&& dump)
+	: _output(output)
+	, _errors(errors)
+	, _dump(std::move(dump))
 	, _commands
 	{
 		{ { "a" }, {},
@@ -14,56 +17,112 @@ Processor::Processor(std::unique_ptr<Minidump>&& dump)
 			[this](const std::vector<std::string>&)
 			{
 				_table = _dump->print_memory();
-			}
+			},
+			Minidump::Memory
 		},
 		{ { "ar" }, {},
 			"Build memory region information.",
 			[this](const std::vector<std::string>&)
 			{
 				_table = _dump->print_memory_regions();
-			}
+			},
+			Minidump::MemoryRegions
+		},
+		{ { "diff" }, { "DUMP" },
+			"Build the lists of modules, threads (by start function) and handles (by type) added, removed or changed in DUMP.",
+			[this](const std::vector<std::string>& args)
+			{
+				_table = _dump->print_diff(args[0]);
+			},
+			Minidump::Modules | Minidump::Threads | Minidump::Memory | Minidump::Handles | Minidump::UnloadedModules
+		},
+		{ { "f" }, { "PATTERN" },
+			"Build a list of addresses of PATTERN (\"text\", u\"text\" or hexadecimal bytes, without spaces or '|') in memory.",
+			[this](const std::vector<std::string>& args)
+			{
+				_table = _dump->print_pattern_matches(::parse_pattern(args[0]));
+			},
+			Minidump::Memory
 		},
 		{ { "h" }, {},
 			"Build handle information.",
 			[this](const std::vector<std::string>&)
 			{
 				_table = _dump->print_handles();
-			}
+			},
+			Minidump::Handles
 		},
 		{ { "m" }, {},
 			"Build loaded modules list.",
 			[this](const std::vector<std::string>&)
 			{
 				_table = _dump->print_modules();
-			}
+			},
+			Minidump::Modules
+		},
+		{ { "refs" }, { "ADDRESS", "[SIZE]" },
+			"Build a list of aligned pointers to ADDRESS or to SIZE bytes starting at ADDRESS (both hexadecimal).",
+			[this](const std::vector<std::string>& args)
+			{
+				_table = _dump->print_references(::from_hex(args[0]), args.size() > 1 ? ::from_hex(args[1]) : 1);
+			},
+			Minidump::Memory
+		},
+		{ { "sig" }, { "[FRAMES]" },
+			"Build the crash signature from the exception code and the top FRAMES (5 by default) frames.",
+			[this](const std::vector<std::string>& args)
+			{
+				_table = _dump->print_signature(args.empty() ? 5 : ::to_ulong(args[0]));
+			},
+			Minidump::Modules | Minidump::Exception | Minidump::Memory | Minidump::UnloadedModules
 		},
 		{ { "t" }, { "INDEX" },
 			"Build the stack of thread INDEX.",
 			[this](const std::vector<std::string>& args)
 			{
 				_table = _dump->print_thread_call_stack(::to_ulong(args[0]));
-			}
+			},
+			Minidump::Modules | Minidump::Exception | Minidump::Memory | Minidump::UnloadedModules
+		},
+		{ { "ta" }, {},
+			"Build the stacks of all threads.",
+			[this](const std::vector<std::string>&)
+			{
+				_table = _dump->print_all_call_stacks();
+			},
+			Minidump::Modules | Minidump::Exception | Minidump::Memory | Minidump::UnloadedModules
 		},
 		{ { "ts" }, {},
 			"Build thread list.",
 			[this](const std::vector<std::string>&)
 			{
 				_table = _dump->print_threads();
-			}
+			},
+			Minidump::Modules | Minidump::Exception | Minidump::Memory | Minidump::UnloadedModules
+		},
+		{ { "tu" }, {},
+			"Build the list of unique thread stacks with the threads sharing each one.",
+			[this](const std::vector<std::string>&)
+			{
+				_table = _dump->print_unique_call_stacks();
+			},
+			Minidump::Modules | Minidump::Exception | Minidump::Memory | Minidump::UnloadedModules
 		},
 		{ { "um" }, {},
 			"Build unloaded modules list.",
 			[this](const std::vector<std::string>&)
 			{
 				_table = _dump->print_unloaded_modules();
-			}
+			},
+			Minidump::UnloadedModules
 		},
 		{ { "x" }, {},
 			"Build the exception call stack.",
 			[this](const std::vector<std::string>&)
 			{
 				_table = _dump->print_exception_call_stack();
-			}
+			},
+			Minidump::Modules | Minidump::Exception | Minidump::Memory | Minidump::UnloadedModules
 		},
 		{ { "." }, {},
 			"Do nothing.",
@@ -75,7 +134,7 @@ Processor::Processor(std::unique_ptr<Minidump>&& dump)
 			"Leave rows where value in COLUMN is empty.",
 			[this](const std::vector<std::string>& args)
 			{
-				_table.filter(args[0], "", Table::Pass::EndingWith);
+				_table.filter(args[0], "", Table::Pass::Equal);
 			}
 		},
 		{ { ".ends", ".e" }, { "COLUMN", "TEXT" },
@@ -191,15 +250,24 @@ Processor::Processor(std::unique_ptr<Minidump>&& dump)
 						signature += ' ' + argument;
 					table.push_back({signature, command.description});
 				}
-				table.print(std::cout);
+				table.print(_output);
 			}
 		},
+		{ { "?mem" }, { "ADDRESS", "SIZE" },
+			"Print raw memory data of SIZE bytes at ADDRESS (both hexadecimal).",
+			[this](const std::vector<std::string>& args)
+			{
+				_dump->print_memory_data(_output, ::from_hex(args[0]), ::from_hex(args[1]));
+			},
+			Minidump::Memory
+		},
 		{ { "?rawstack" }, { "INDEX" },
 			"Print raw stack data of thread INDEX.",
 			[this](const std::vector<std::string>& args)
 			{
-				_dump->print_thread_raw_stack(::to_ulong(args[0]));
-			}
+				_dump->print_thread_raw_stack(_output, ::to_ulong(args[0]));
+			},
+			Minidump::Memory
 		},
 		{ { "?rows", "?r" }, {},
 			"Print the number of rows in the current output (excluding filtered rows).",
@@ -207,7 +275,7 @@ Processor::Processor(std::unique_ptr<Minidump>&& dump)
 			{
 				Table table({{""}, {"", Table::Alignment::Right}});
 				table.push_back({"Rows:", std::to_string(_table.rows())});
-				table.print(std::cout);
+				table.print(_output);
 			}
 		},
 		{ { "?time", "?t" }, {},
@@ -217,7 +285,7 @@ Processor::Processor(std::unique_ptr<Minidump>&& dump)
 				Table table({{""}, {"", Table::Alignment::Right}});
 				table.push_back({"Last command time:", std::to_string(_last_command_time) + " ms"});
 				table.push_back({"Last print time:", std::to_string(_last_print_time) + " ms"});
-				table.print(std::cout);
+				table.print(_output);
 			}
 		},
 	}
@@ -232,6 +300,14 @@ Processor::Processor(std::unique_ptr<Minidump>&& dump)
 
 Processor::~Processor() = default;
 
+unsigned Processor::content(const std::string& commands) const
+{
+	unsigned result = 0;
+	for (const auto& parsed_command : parser::parse(_command_index, commands))
+		result |= parsed_command.first->requirements;
+	return result;
+}
+
 bool Processor::process(const std::string& commands)
 {
 	try
@@ -248,7 +324,7 @@ bool Processor::process(const std::string& commands)
 		if (print_table)
 		{
 			const auto start_time = std::chrono::steady_clock::now();
-			_table.print(std::cout);
+			_table.print(_output);
 			const auto end_time = std::chrono::steady_clock::now();
 			_last_print_time = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
 		}
@@ -257,7 +333,7 @@ bool Processor::process(const std::string& commands)
 	catch (const std::exception& e) // TODO: Should we catch std::logic_error here?
 	{
 		_table = {};
-		std::cerr << "ERROR: " << e.what() << std::endl;
+		_errors << "ERROR: " << e.what() << std::endl;
 		return false;
 	}
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "table.h"
+#include <functional>
+#include <iosfwd>
 #include <memory>
 #include <unordered_map>
 
@@ -15,11 +17,17 @@ class Processor
 {
 public:
 
-	Processor(std::unique_ptr<Minidump>&&);
+	// Command output and errors are written to the specified streams.
+	Processor(std::ostream& output, std::ostream& errors, std::unique_ptr<Minidump>&& = nullptr);
 	~Processor();
 
 	bool process(const std::string& commands);
 
+	// Returns Minidump::Content needed to process the commands.
+	unsigned content(const std::string& commands) const;
+
+	void set_dump(std::unique_ptr<Minidump>&& dump) { _dump = std::move(dump); }
+
 private:
 
 	struct Command
@@ -34,7 +42,9 @@ private:
 		std::function<void(const std::vector<std::string>&)> handler;
 	};
 
-	const std::unique_ptr<Minidump> _dump;
+	std::ostream& _output;
+	std::ostream& _errors;
+	std::unique_ptr<Minidump> _dump;
 	Table _table;
 	const std::vector<parser::Command> _commands;
 	std::unordered_map<std::string, const parser::Command*> _command_index;
@@ -0,0 +1,130 @@
+#include "scan.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#	include <emmintrin.h>
+#endif
+
+std::string parse_pattern(const std::string& source)
+{
+	// Empty patterns aren't valid, as they would match everywhere.
+	if (source.size() > 2 && source.front() == '"' && source.back() == '"')
+		return source.substr(1, source.size() - 2);
+	if (source.size() > 3 && source.compare(0, 2, "u\"") == 0 && source.back() == '"')
+	{
+		std::string pattern;
+		for (size_t i = 2; i < source.size() - 1; ++i)
+		{
+			pattern.push_back(source[i]);
+			pattern.push_back('\0');
+		}
+		return pattern;
+	}
+	if (source.empty() || source.size() % 2 || source.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)
+		throw std::runtime_error("Invalid pattern: " + source);
+	std::string pattern;
+	for (size_t i = 0; i < source.size(); i += 2)
+		pattern.push_back(static_cast<char>(std::stoul(source.substr(i, 2), nullptr, 16)));
+	return pattern;
+}
+
+void find_values(const uint8_t* data, size_t size, bool is_32bit, uint64_t low, uint64_t count, std::vector<size_t>& offsets)
+{
+	// A value is in range if (value - low) < count, with unsigned comparison.
+	size_t offset = 0;
+	if (is_32bit)
+	{
+		const auto low32 = static_cast<uint32_t>(low);
+		const auto count32 = static_cast<uint32_t>(std::min<uint64_t>(count, UINT32_MAX));
+#if defined(__SSE2__)
+		const auto sign = _mm_set1_epi32(INT32_MIN);
+		const auto low_vector = _mm_set1_epi32(static_cast<int32_t>(low32));
+		const auto count_vector = _mm_xor_si128(_mm_set1_epi32(static_cast<int32_t>(count32)), sign);
+		for (; offset + 16 <= size; offset += 16)
+		{
+			const auto values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset));
+			const auto differences = _mm_xor_si128(_mm_sub_epi32(values, low_vector), sign);
+			auto mask = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(differences, count_vector))));
+			for (; mask; mask &= mask - 1)
+				offsets.emplace_back(offset + 4 * __builtin_ctz(mask));
+		}
+#endif
+		for (; offset + 4 <= size; offset += 4)
+		{
+			uint32_t value;
+			::memcpy(&value, data + offset, sizeof value);
+			if (value - low32 < count32)
+				offsets.emplace_back(offset);
+		}
+	}
+	else
+	{
+#if defined(__SSE2__)
+		// SSE2 has no 64-bit comparison, so it is composed of 32-bit comparisons of high and low halves.
+		const auto sign = _mm_set1_epi32(INT32_MIN);
+		const auto low_vector = _mm_set1_epi64x(static_cast<int64_t>(low));
+		const auto count_vector = _mm_xor_si128(_mm_set1_epi64x(static_cast<int64_t>(count)), sign);
+		for (; offset + 16 <= size; offset += 16)
+		{
+			const auto values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset));
+			const auto differences = _mm_xor_si128(_mm_sub_epi64(values, low_vector), sign);
+			const auto less = _mm_cmplt_epi32(differences, count_vector);
+			const auto equal = _mm_cmpeq_epi32(differences, count_vector);
+			const auto result = _mm_or_si128(less, _mm_and_si128(equal, _mm_slli_epi64(less, 32)));
+			auto mask = static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(result)));
+			for (; mask; mask &= mask - 1)
+				offsets.emplace_back(offset + 8 * __builtin_ctz(mask));
+		}
+#endif
+		for (; offset + 8 <= size; offset += 8)
+		{
+			uint64_t value;
+			::memcpy(&value, data + offset, sizeof value);
+			if (value - low < count)
+				offsets.emplace_back(offset);
+		}
+	}
+}
+
+void find_pattern(const uint8_t* data, size_t size, size_t limit, const std::string& pattern, std::vector<size_t>& offsets)
+{
+	if (pattern.empty() || size < pattern.size() || !limit)
+		return;
+	const auto pattern_data = reinterpret_cast<const uint8_t*>(pattern.data());
+	const auto last = std::min(size - pattern.size(), limit - 1); // Last offset to check.
+	const auto check = [data, &pattern, pattern_data, &offsets](size_t offset)
+	{
+		if (!::memcmp(data + offset, pattern_data, pattern.size()))
+			offsets.emplace_back(offset);
+	};
+
+	size_t offset = 0;
+#if defined(__SSE2__)
+	// Filter candidates by the first two pattern bytes, sixteen offsets at a time.
+	if (pattern.size() >= 2)
+	{
+		const auto first = _mm_set1_epi8(static_cast<char>(pattern_data[0]));
+		const auto second = _mm_set1_epi8(static_cast<char>(pattern_data[1]));
+		for (; offset + 15 <= last; offset += 16)
+		{
+			const auto first_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset));
+			const auto second_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset + 1));
+			auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(
+				_mm_cmpeq_epi8(first_block, first), _mm_cmpeq_epi8(second_block, second))));
+			for (; mask; mask &= mask - 1)
+				check(offset + __builtin_ctz(mask));
+		}
+	}
+#endif
+	for (; offset <= last; )
+	{
+		const auto candidate = static_cast<const uint8_t*>(::memchr(data + offset, pattern_data[0], last - offset + 1));
+		if (!candidate)
+			break;
+		offset = candidate - data;
+		check(offset);
+		++offset;
+	}
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Parses a non-empty search pattern: "text" for ASCII, u"text" for UTF-16 or hexadecimal bytes.
+std::string parse_pattern(const std::string&);
+
+// Appends offsets of aligned 32-bit or 64-bit values in range [low, low + count) to the result.
+void find_values(const uint8_t* data, size_t size, bool is_32bit, uint64_t low, uint64_t count, std::vector<size_t>& offsets);
+
+// Appends offsets of all pattern occurrences starting before 'limit' to the result.
+void find_pattern(const uint8_t* data, size_t size, size_t limit, const std::string& pattern, std::vector<size_t>& offsets);
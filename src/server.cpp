@@ -0,0 +1,234 @@
+#include "server.h"
+#include "check.h"
+#include "minidump.h"
+#include "processor.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+	std::runtime_error system_error(const std::string& message)
+	{
+		return std::runtime_error(message + ": " + ::strerror(errno));
+	}
+
+	// Loaded dumps keyed by path. A dump is reloaded if its file changes, and the least recently
+	// used dump is dropped when there are too many. Clients keep using the data of dropped dumps.
+	class DumpPool
+	{
+	public:
+
+		DumpPool(const std::shared_ptr<const Symbols>& symbols, bool use_index) : _symbols(symbols), _use_index(use_index) {}
+
+		// Returns a dump sharing the loaded data.
+		std::unique_ptr<Minidump> open(const std::string& path);
+
+	private:
+
+		static constexpr size_t MaxDumps = 16;
+
+		struct Entry
+		{
+			std::once_flag once;
+			uint64_t last_use = 0;
+			time_t modification_time = 0;
+			off_t size = 0;
+			std::unique_ptr<Minidump> dump;
+			std::string error;
+		};
+
+		const std::shared_ptr<const Symbols> _symbols;
+		const bool _use_index;
+		std::mutex _mutex;
+		std::map<std::string, std::shared_ptr<Entry>> _entries;
+		uint64_t _use_count = 0;
+	};
+
+	std::unique_ptr<Minidump> DumpPool::open(const std::string& path)
+	{
+		struct ::stat stat;
+		if (::stat(path.c_str(), &stat) != 0)
+			throw ::system_error("Couldn't open \"" + path + "\"");
+		std::shared_ptr<Entry> entry;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto& slot = _entries[path];
+			if (!slot || slot->modification_time != stat.st_mtime || slot->size != stat.st_size)
+			{
+				slot = std::make_shared<Entry>();
+				slot->modification_time = stat.st_mtime;
+				slot->size = stat.st_size;
+			}
+			slot->last_use = ++_use_count;
+			entry = slot;
+			if (_entries.size() > MaxDumps)
+			{
+				const auto oldest = std::min_element(_entries.begin(), _entries.end(),
+					[](const auto& a, const auto& b) { return a.second->last_use < b.second->last_use; });
+				_entries.erase(oldest);
+			}
+		}
+		std::call_once(entry->once, [this, &entry, &path]
+		{
+			try
+			{
+				entry->dump = std::make_unique<Minidump>(path, false, Minidump::All, _use_index);
+				entry->dump->set_symbols(_symbols);
+			}
+			catch (const BadCheck& e)
+			{
+				entry->error = e.what();
+			}
+		});
+		if (!entry->dump)
+		{
+			// Failures aren't cached, so a dump that is still being written can be opened later.
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				const auto i = _entries.find(path);
+				if (i != _entries.end() && i->second == entry)
+					_entries.erase(i);
+			}
+			throw std::runtime_error(entry->error);
+		}
+		return std::make_unique<Minidump>(*entry->dump);
+	}
+
+	class Connection
+	{
+	public:
+
+		Connection(int socket) : _socket(socket) {}
+		~Connection() { ::close(_socket); }
+
+		bool read_line(std::string& line);
+		bool write(const std::string& data);
+
+	private:
+		const int _socket;
+		std::string _buffer;
+	};
+
+	bool Connection::read_line(std::string& line)
+	{
+		for (;;)
+		{
+			const auto end = _buffer.find('\n');
+			if (end != std::string::npos)
+			{
+				line.assign(_buffer, 0, end > 0 && _buffer[end - 1] == '\r' ? end - 1 : end);
+				_buffer.erase(0, end + 1);
+				return true;
+			}
+			char data[4096];
+			const auto size = ::recv(_socket, data, sizeof data, 0);
+			if (size <= 0)
+			{
+				if (size < 0 && errno == EINTR)
+					continue;
+				return false;
+			}
+			_buffer.append(data, size);
+		}
+	}
+
+	bool Connection::write(const std::string& data)
+	{
+		for (size_t offset = 0; offset < data.size(); )
+		{
+			const auto size = ::send(_socket, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+			if (size < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				return false;
+			}
+			offset += size;
+		}
+		return true;
+	}
+
+	void serve_client(DumpPool& pool, int socket)
+	{
+		Connection connection(socket);
+		std::string line;
+		if (!connection.read_line(line))
+			return;
+		std::ostringstream output;
+		std::unique_ptr<Minidump> dump;
+		try
+		{
+			dump = pool.open(line);
+		}
+		catch (const std::exception& e)
+		{
+			output << "FATAL: " << e.what() << '\n';
+		}
+		output << '\0';
+		if (!connection.write(output.str()) || !dump)
+			return;
+		Processor processor(output, output, std::move(dump));
+		while (connection.read_line(line))
+		{
+			output.str({});
+			processor.process(line);
+			output << '\0';
+			if (!connection.write(output.str()))
+				break;
+		}
+	}
+}
+
+void run_server(const std::string& socket_path, const std::shared_ptr<const Symbols>& symbols, bool use_index)
+{
+	::sockaddr_un address;
+	::memset(&address, 0, sizeof address);
+	address.sun_family = AF_UNIX;
+	if (socket_path.size() >= sizeof address.sun_path)
+		throw std::runtime_error("Socket path is too long: " + socket_path);
+	::memcpy(address.sun_path, socket_path.c_str(), socket_path.size());
+
+	// A socket left by a previous server would make binding fail.
+	struct ::stat stat;
+	if (::stat(socket_path.c_str(), &stat) == 0 && S_ISSOCK(stat.st_mode))
+		::unlink(socket_path.c_str());
+
+	const auto server = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server == -1)
+		throw ::system_error("Couldn't create socket");
+
+	// Clients can make the server read any file it can, so only the owner may connect.
+	const auto old_umask = ::umask(0077);
+	const auto bound = ::bind(server, reinterpret_cast<const ::sockaddr*>(&address), sizeof address) == 0;
+	::umask(old_umask);
+	if (!bound || ::listen(server, SOMAXCONN) != 0)
+	{
+		const auto error = ::system_error("Couldn't listen on \"" + socket_path + "\"");
+		::close(server);
+		throw error;
+	}
+
+	DumpPool pool(symbols, use_index);
+	for (;;)
+	{
+		const auto client = ::accept(server, nullptr, nullptr);
+		if (client == -1)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			const auto error = ::system_error("Couldn't accept connection");
+			::close(server);
+			throw error;
+		}
+		std::thread([&pool, client] { ::serve_client(pool, client); }).detach();
+	}
+}
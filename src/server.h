@@ -0,0 +1,12 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+class Symbols;
+
+// Serves command pipelines over a Unix domain socket until the process is terminated.
+// A client sends a dump path line followed by command lines and receives the output of each line
+// terminated with a zero byte. Loaded dumps are shared between clients, and each client has its own output table.
+// Only the user running the server may connect to the socket.
+void run_server(const std::string& socket_path, const std::shared_ptr<const Symbols>&, bool use_index);
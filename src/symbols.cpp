@@ -0,0 +1,511 @@
+#include "symbols.h"
+#include "check.h"
+#include "pdb.h"
+#include "utils.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <dirent.h>
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+	namespace compiled
+	{
+		struct Header
+		{
+			char     signature[8];
+			uint32_t function_count;
+			uint32_t public_count;
+			uint32_t line_count;
+			uint32_t strings_size;
+
+			static constexpr char Signature[8] = {'W', 'H', 'Y', 'S', 'Y', 'M', '0', '1'};
+		};
+
+		constexpr char Header::Signature[8];
+
+		struct Function
+		{
+			uint32_t rva;
+			uint32_t size;
+			uint32_t name; // Offset in the string table.
+		};
+
+		struct Public
+		{
+			uint32_t rva;
+			uint32_t name; // Offset in the string table.
+		};
+
+		struct Line
+		{
+			uint32_t rva;
+			uint32_t size;
+			uint32_t line;
+			uint32_t file; // File number while compiling, offset in the string table afterwards.
+		};
+	}
+
+	// Splits a Breakpad symbol file line into space-separated fields.
+	class LineParser
+	{
+	public:
+		LineParser(const char* begin, const char* end) : _position(begin), _end(end) {}
+
+		bool at_end() const { return _position == _end; }
+
+		std::string next()
+		{
+			const auto begin = _position;
+			_position = std::find(_position, _end, ' ');
+			std::string result(begin, _position);
+			if (_position != _end)
+				++_position;
+			return result;
+		}
+
+		uint32_t next_hex()
+		{
+			uint64_t value = 0;
+			const auto begin = _position;
+			for (; _position != _end && *_position != ' '; ++_position)
+			{
+				const auto c = *_position;
+				if (c >= '0' && c <= '9')
+					value = value * 16 + (c - '0');
+				else if (c >= 'a' && c <= 'f')
+					value = value * 16 + (c - 'a' + 10);
+				else if (c >= 'A' && c <= 'F')
+					value = value * 16 + (c - 'A' + 10);
+				else
+					throw BadCheck("Bad hexadecimal number");
+				CHECK(value <= UINT32_MAX, "Hexadecimal number is too large");
+			}
+			CHECK(_position != begin, "Missing hexadecimal number");
+			if (_position != _end)
+				++_position;
+			return static_cast<uint32_t>(value);
+		}
+
+		uint32_t next_decimal()
+		{
+			const auto field = next();
+			CHECK(!field.empty() && std::all_of(field.begin(), field.end(), ::isdigit), "Bad decimal number");
+			return static_cast<uint32_t>(std::stoul(field));
+		}
+
+		std::string rest() { std::string result(_position, _end); _position = _end; return result; }
+
+		void skip_multiple()
+		{
+			if (_end - _position >= 2 && _position[0] == 'm' && _position[1] == ' ')
+				_position += 2;
+		}
+
+	private:
+		const char* _position;
+		const char* const _end;
+	};
+
+	class StringTable
+	{
+	public:
+		uint32_t add(const std::string& string)
+		{
+			const auto offset = _data.size();
+			CHECK(offset + string.size() < UINT32_MAX, "Symbol string table is too large");
+			_data.append(string).push_back('\0');
+			return static_cast<uint32_t>(offset);
+		}
+
+		const std::string& data() const { return _data; }
+
+	private:
+		std::string _data;
+	};
+
+	template <typename T>
+	void append(std::vector<uint8_t>& buffer, const std::vector<T>& values)
+	{
+		const auto data = reinterpret_cast<const uint8_t*>(values.data());
+		buffer.insert(buffer.end(), data, data + values.size() * sizeof(T));
+	}
+
+	std::vector<uint8_t> build(std::vector<compiled::Function>&& functions, std::vector<compiled::Public>&& publics,
+		std::vector<compiled::Line>&& lines, const StringTable& strings)
+	{
+		std::sort(functions.begin(), functions.end(), [](const auto& a, const auto& b) { return a.rva < b.rva; });
+		std::sort(publics.begin(), publics.end(), [](const auto& a, const auto& b) { return a.rva < b.rva; });
+		std::sort(lines.begin(), lines.end(), [](const auto& a, const auto& b) { return a.rva < b.rva; });
+
+		compiled::Header header;
+		std::copy(std::begin(compiled::Header::Signature), std::end(compiled::Header::Signature), header.signature);
+		header.function_count = functions.size();
+		header.public_count = publics.size();
+		header.line_count = lines.size();
+		header.strings_size = strings.data().size();
+
+		std::vector<uint8_t> buffer;
+		buffer.reserve(sizeof header + functions.size() * sizeof(compiled::Function) + publics.size() * sizeof(compiled::Public)
+			+ lines.size() * sizeof(compiled::Line) + strings.data().size());
+		buffer.insert(buffer.end(), reinterpret_cast<const uint8_t*>(&header), reinterpret_cast<const uint8_t*>(&header + 1));
+		::append(buffer, functions);
+		::append(buffer, publics);
+		::append(buffer, lines);
+		buffer.insert(buffer.end(), strings.data().begin(), strings.data().end());
+		return buffer;
+	}
+
+	time_t modification_time(const std::string& path)
+	{
+		struct ::stat stat;
+		return ::stat(path.c_str(), &stat) == 0 ? stat.st_mtime : 0;
+	}
+
+	// Returns nullptr if the file isn't a valid compiled symbol table, so that it is compiled again.
+	std::unique_ptr<SymbolTable> open_table(File&& file)
+	{
+		if (!file)
+			return nullptr;
+		try
+		{
+			return std::make_unique<SymbolTable>(std::move(file));
+		}
+		catch (const BadCheck&)
+		{
+			return nullptr;
+		}
+	}
+
+	bool ends_with(const std::string& string, const char* suffix)
+	{
+		const auto size = ::strlen(suffix);
+		return string.size() >= size && string.compare(string.size() - size, size, suffix) == 0;
+	}
+}
+
+std::vector<uint8_t> SymbolTable::compile(const File& sym_file)
+{
+	const auto data = sym_file.view<char>(0, sym_file.size());
+	CHECK(data, "Couldn't read symbol file");
+
+	std::vector<compiled::Function> functions;
+	std::vector<compiled::Public> publics;
+	std::vector<compiled::Line> lines;
+	std::map<uint32_t, uint32_t> files;
+	StringTable strings;
+	bool has_module = false;
+	for (auto begin = data, end = data + sym_file.size(); begin != end; )
+	{
+		auto line_end = std::find(begin, end, '\n');
+		const auto next = line_end != end ? line_end + 1 : end;
+		if (line_end != begin && line_end[-1] == '\r')
+			--line_end;
+		LineParser parser(begin, line_end);
+		const auto first = *begin;
+		begin = next;
+		if (parser.at_end())
+			continue;
+		if (!has_module)
+		{
+			CHECK(parser.next() == "MODULE", "Not a Breakpad symbol file");
+			has_module = true;
+		}
+		else if ((first >= '0' && first <= '9') || (first >= 'a' && first <= 'f'))
+		{
+			// Line records have lowercase addresses, so they never clash with uppercase record types.
+			compiled::Line line;
+			line.rva = parser.next_hex();
+			line.size = parser.next_hex();
+			line.line = parser.next_decimal();
+			line.file = parser.next_decimal();
+			lines.emplace_back(line);
+		}
+		else
+		{
+			const auto type = parser.next();
+			if (type == "FILE")
+			{
+				const auto number = parser.next_decimal();
+				files[number] = strings.add(parser.rest());
+			}
+			else if (type == "FUNC")
+			{
+				parser.skip_multiple();
+				compiled::Function function;
+				function.rva = parser.next_hex();
+				function.size = parser.next_hex();
+				parser.next_hex(); // Parameter size.
+				function.name = strings.add(parser.rest());
+				functions.emplace_back(function);
+			}
+			else if (type == "PUBLIC")
+			{
+				parser.skip_multiple();
+				compiled::Public symbol;
+				symbol.rva = parser.next_hex();
+				parser.next_hex(); // Parameter size.
+				symbol.name = strings.add(parser.rest());
+				publics.emplace_back(symbol);
+			}
+			// Other records (INFO, STACK, INLINE, INLINE_ORIGIN) aren't needed for symbolization.
+		}
+	}
+	CHECK(has_module, "Empty symbol file");
+
+	const auto empty_file = strings.add({});
+	for (auto& line : lines)
+	{
+		const auto i = files.find(line.file);
+		line.file = i != files.end() ? i->second : empty_file;
+	}
+
+	return ::build(std::move(functions), std::move(publics), std::move(lines), strings);
+}
+
+std::vector<uint8_t> SymbolTable::compile(std::vector<std::pair<uint32_t, std::string>>&& public_symbols)
+{
+	std::vector<compiled::Public> publics;
+	publics.reserve(public_symbols.size());
+	StringTable strings;
+	for (const auto& symbol : public_symbols)
+		publics.push_back({symbol.first, strings.add(symbol.second)});
+	strings.add({}); // The string table must not be empty.
+	return ::build({}, std::move(publics), {}, strings);
+}
+
+SymbolTable::SymbolTable(File&& file)
+	: _file(std::move(file))
+{
+	_data = _file.view<uint8_t>(0, _file.size());
+	validate(_file.size());
+}
+
+SymbolTable::SymbolTable(std::vector<uint8_t>&& buffer)
+	: _buffer(std::move(buffer))
+{
+	_data = _buffer.data();
+	validate(_buffer.size());
+}
+
+void SymbolTable::validate(size_t size)
+{
+	CHECK(_data && size >= sizeof(compiled::Header), "Bad symbol table");
+	const auto& header = *reinterpret_cast<const compiled::Header*>(_data);
+	CHECK(std::equal(std::begin(header.signature), std::end(header.signature), compiled::Header::Signature), "Bad symbol table signature");
+	CHECK_EQ(size, sizeof header
+		+ uint64_t{header.function_count} * sizeof(compiled::Function)
+		+ uint64_t{header.public_count} * sizeof(compiled::Public)
+		+ uint64_t{header.line_count} * sizeof(compiled::Line)
+		+ header.strings_size, "Bad symbol table size");
+	CHECK(header.strings_size > 0 && _data[size - 1] == '\0', "Bad symbol table strings");
+}
+
+bool SymbolTable::find(uint32_t rva, Symbol& symbol) const
+{
+	const auto& header = *reinterpret_cast<const compiled::Header*>(_data);
+	const auto functions = reinterpret_cast<const compiled::Function*>(&header + 1);
+	const auto publics = reinterpret_cast<const compiled::Public*>(functions + header.function_count);
+	const auto lines = reinterpret_cast<const compiled::Line*>(publics + header.public_count);
+	const auto strings = reinterpret_cast<const char*>(lines + header.line_count);
+	const auto string = [&header, strings](uint32_t offset)
+	{
+		return offset < header.strings_size ? strings + offset : "";
+	};
+
+	// Functions cover their whole code, public symbols extend up to the next public symbol.
+	const auto function = std::upper_bound(functions, functions + header.function_count, rva, [](uint32_t rva, const auto& function) { return rva < function.rva; });
+	if (function != functions && rva - function[-1].rva < function[-1].size)
+	{
+		symbol.name = string(function[-1].name);
+		symbol.offset = rva - function[-1].rva;
+	}
+	else
+	{
+		const auto public_symbol = std::upper_bound(publics, publics + header.public_count, rva, [](uint32_t rva, const auto& symbol) { return rva < symbol.rva; });
+		if (public_symbol == publics)
+			return false;
+		symbol.name = string(public_symbol[-1].name);
+		symbol.offset = rva - public_symbol[-1].rva;
+	}
+
+	const auto line = std::upper_bound(lines, lines + header.line_count, rva, [](uint32_t rva, const auto& line) { return rva < line.rva; });
+	if (line != lines && rva - line[-1].rva < line[-1].size)
+	{
+		symbol.file = string(line[-1].file);
+		symbol.line = line[-1].line;
+	}
+	else
+	{
+		symbol.file.clear();
+		symbol.line = 0;
+	}
+	return true;
+}
+
+const SymbolTable* Symbols::find(const std::string& pdb_name, const std::string& pdb_id) const
+{
+	if (pdb_name.empty() || pdb_id.empty())
+		return nullptr;
+	Entry* entry = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto& slot = _entries[pdb_name + '/' + pdb_id];
+		if (!slot)
+			slot = std::make_unique<Entry>();
+		entry = slot.get();
+	}
+	std::call_once(entry->once, [this, entry, &pdb_name, &pdb_id]
+	{
+		try
+		{
+			entry->table = load(pdb_name, pdb_id);
+		}
+		catch (const BadCheck& e)
+		{
+			std::cerr << "ERROR: [" << pdb_name << "] " << e.what() << std::endl;
+		}
+	});
+	return entry->table.get();
+}
+
+std::unique_ptr<SymbolTable> Symbols::load(const std::string& pdb_name, const std::string& pdb_id) const
+{
+	auto base_name = pdb_name;
+	if (base_name.size() >= 4 && ::strcasecmp(base_name.c_str() + base_name.size() - 4, ".pdb") == 0)
+		base_name.resize(base_name.size() - 4);
+
+	// The name comes from the dump and must not lead out of the symbol directory.
+	if (base_name.empty() || pdb_name == "." || pdb_name == ".." || pdb_name.find('/') != std::string::npos)
+		return nullptr;
+
+	std::string source_path;
+	auto source = SymbolCache::Source::Breakpad;
+	time_t source_time = 0;
+	if (!_directory.empty())
+	{
+		const auto directory = _directory + '/' + pdb_name + '/' + pdb_id + '/';
+		source_path = directory + base_name + ".sym";
+		source_time = ::modification_time(source_path);
+		if (!source_time)
+		{
+			source_path = directory + pdb_name;
+			source = SymbolCache::Source::Pdb;
+			source_time = ::modification_time(source_path);
+		}
+	}
+
+	// A table compiled from a PDB isn't used once Breakpad symbols are added.
+	// Without source files, tables compiled from either are used, Breakpad ones first.
+	if (_cache)
+	{
+		for (const auto cached_source : {SymbolCache::Source::Breakpad, SymbolCache::Source::Pdb})
+		{
+			if (source_time && cached_source != source)
+				continue;
+			auto table = ::open_table(_cache->find(pdb_name, pdb_id, cached_source));
+			if (table)
+				return table;
+		}
+	}
+	if (!source_time)
+		return nullptr;
+
+	const auto table_path = source_path + ".whysym";
+	if (!_cache && ::modification_time(table_path) >= source_time)
+	{
+		auto table = ::open_table(File(table_path));
+		if (table)
+			return table;
+	}
+
+	File source_file(source_path);
+	CHECK(source_file, "Couldn't open " << source_path);
+	std::vector<uint8_t> buffer;
+	if (source == SymbolCache::Source::Pdb)
+	{
+		const Pdb pdb(std::move(source_file));
+		CHECK_EQ(pdb.id(), pdb_id, "PDB mismatch");
+		buffer = SymbolTable::compile(pdb.public_symbols());
+	}
+	else
+		buffer = SymbolTable::compile(source_file);
+
+	// Failing to write the table (e.g. into a read-only symbol directory) only means it will be compiled again.
+	if (_cache)
+		_cache->store(pdb_name, pdb_id, source, buffer);
+	else
+		::write_file(table_path, buffer);
+	return std::make_unique<SymbolTable>(std::move(buffer));
+}
+
+File SymbolCache::find(const std::string& pdb_name, const std::string& pdb_id, Source source) const
+{
+	const auto table_path = path(pdb_name, pdb_id, source);
+	File file(table_path);
+	if (file)
+		::utimensat(AT_FDCWD, table_path.c_str(), nullptr, 0); // Modification time is the last use time.
+	return file;
+}
+
+bool SymbolCache::store(const std::string& pdb_name, const std::string& pdb_id, Source source, const std::vector<uint8_t>& table) const
+{
+	const auto table_path = path(pdb_name, pdb_id, source);
+	if (!::write_file(table_path, table))
+		return false;
+	evict(table_path);
+	return true;
+}
+
+std::string SymbolCache::path(const std::string& pdb_name, const std::string& pdb_id, Source source) const
+{
+	auto file_name = pdb_name + '.' + pdb_id + (source == Source::Pdb ? ".pdb" : ".sym") + ".whysym";
+	std::replace(file_name.begin(), file_name.end(), '/', '_');
+	return _directory + '/' + file_name;
+}
+
+void SymbolCache::evict(const std::string& keep_path) const
+{
+	// Temporary files older than this are left from processes which didn't finish writing.
+	static const time_t abandoned_age = 60 * 60;
+
+	const auto directory = ::opendir(_directory.c_str());
+	if (!directory)
+		return;
+	std::vector<std::pair<time_t, std::pair<std::string, uint64_t>>> tables;
+	uint64_t total_size = 0;
+	const auto now = ::time(nullptr);
+	while (const auto entry = ::readdir(directory))
+	{
+		const std::string name = entry->d_name;
+		const auto is_table = ::ends_with(name, ".whysym");
+		if (!is_table && !::ends_with(name, ".tmp"))
+			continue;
+		const auto entry_path = _directory + '/' + name;
+		struct ::stat stat;
+		if (::stat(entry_path.c_str(), &stat) != 0 || !S_ISREG(stat.st_mode))
+			continue;
+		if (!is_table)
+		{
+			if (now - stat.st_mtime > abandoned_age)
+				::unlink(entry_path.c_str());
+			continue;
+		}
+		total_size += stat.st_size;
+		if (entry_path != keep_path)
+			tables.emplace_back(stat.st_mtime, std::make_pair(entry_path, stat.st_size));
+	}
+	::closedir(directory);
+
+	// Tables that are in use by other processes stay mapped after being unlinked.
+	std::sort(tables.begin(), tables.end());
+	for (auto i = tables.begin(); i != tables.end() && total_size > _max_size; ++i)
+		if (::unlink(i->second.first.c_str()) == 0)
+			total_size -= i->second.second;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "file.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Source location of a code address.
+struct Symbol
+{
+	std::string name;
+	uint32_t    offset = 0; // Offset of the address from the function start.
+	std::string file;
+	uint32_t    line = 0;   // Zero if no line information is present.
+};
+
+// Sorted function, public symbol and line tables compiled from a Breakpad symbol file or a PDB.
+// The compiled form is used in place, so it can be mapped from disk with no parsing.
+class SymbolTable
+{
+public:
+
+	// Compiles a Breakpad text symbol file, throws BadCheck if the file is malformed.
+	static std::vector<uint8_t> compile(const File& sym_file);
+
+	// Compiles public symbols given as relative virtual addresses and names.
+	static std::vector<uint8_t> compile(std::vector<std::pair<uint32_t, std::string>>&& public_symbols);
+
+	// Both constructors throw BadCheck if the data isn't a valid compiled symbol table.
+	explicit SymbolTable(File&&);
+	explicit SymbolTable(std::vector<uint8_t>&&);
+
+	// Finds the symbol for the relative virtual address.
+	bool find(uint32_t rva, Symbol&) const;
+
+private:
+
+	void validate(size_t size);
+
+private:
+	File _file;
+	std::vector<uint8_t> _buffer;
+	const uint8_t* _data = nullptr;
+};
+
+// Directory of compiled symbol tables keyed by PDB GUID and age and by the kind of file they were compiled from,
+// shared by concurrent processes.
+// Tables are written under temporary names and renamed into place, so readers never see partial files.
+// Least recently used tables are evicted when the total size exceeds the limit.
+class SymbolCache
+{
+public:
+
+	enum class Source
+	{
+		Breakpad,
+		Pdb,
+	};
+
+	SymbolCache(const std::string& directory, uint64_t max_size) : _directory(directory), _max_size(max_size) {}
+
+	// Returns the cached table file (which may be invalid) and marks it as recently used.
+	File find(const std::string& pdb_name, const std::string& pdb_id, Source) const;
+
+	// Stores the table and evicts old tables if the cache is full.
+	// Returns false if the table couldn't be written.
+	bool store(const std::string& pdb_name, const std::string& pdb_id, Source, const std::vector<uint8_t>& table) const;
+
+private:
+
+	std::string path(const std::string& pdb_name, const std::string& pdb_id, Source) const;
+	void evict(const std::string& keep_path) const;
+
+private:
+	const std::string _directory;
+	const uint64_t _max_size;
+};
+
+// Symbol directory, laid out as DIR/PDB_NAME/ID/NAME.sym for Breakpad symbols
+// and as DIR/PDB_NAME/ID/PDB_NAME for PDBs (the symbol store layout).
+// Breakpad symbols take priority. Compiled tables are stored in the cache if there is one
+// and next to the source files otherwise, and reused by later sessions.
+class Symbols
+{
+public:
+
+	// The directory may be empty if only cached tables should be used.
+	explicit Symbols(const std::string& directory, std::unique_ptr<SymbolCache>&& cache = nullptr)
+		: _directory(directory), _cache(std::move(cache)) {}
+
+	// Returns the symbol table for the module, or nullptr if there are no symbols for it.
+	// Tables are loaded on first use; safe to call concurrently.
+	const SymbolTable* find(const std::string& pdb_name, const std::string& pdb_id) const;
+
+private:
+
+	struct Entry
+	{
+		std::once_flag once;
+		std::unique_ptr<SymbolTable> table;
+	};
+
+	std::unique_ptr<SymbolTable> load(const std::string& pdb_name, const std::string& pdb_id) const;
+
+private:
+	const std::string _directory;
+	const std::unique_ptr<SymbolCache> _cache;
+	mutable std::mutex _mutex;
+	mutable std::map<std::string, std::unique_ptr<Entry>> _entries;
+};
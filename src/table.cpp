@@ -1,68 +1,145 @@
 #include "table.h"
 #include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 
+namespace
+{
+	bool is_hex(Table::Format format)
+	{
+		return format == Table::Format::Hex || format == Table::Format::Hex32 || format == Table::Format::Hex64;
+	}
+
+	bool is_numeric(Table::Format format)
+	{
+		return format == Table::Format::Decimal || ::is_hex(format);
+	}
+
+	bool has_hex_prefix(const std::string& value)
+	{
+		return value.compare(0, 2, "0x") == 0 || value.compare(0, 2, "0X") == 0;
+	}
+
+	size_t format_number(Table::Format format, uint64_t value, char (&buffer)[21])
+	{
+		switch (format)
+		{
+		case Table::Format::Decimal:
+			return ::snprintf(buffer, sizeof buffer, "%" PRIu64, value);
+		case Table::Format::Hex:
+			return ::snprintf(buffer, sizeof buffer, "%" PRIx64, value);
+		case Table::Format::Hex32:
+			return ::snprintf(buffer, sizeof buffer, "%08" PRIx32, static_cast<uint32_t>(value));
+		default:
+			return ::snprintf(buffer, sizeof buffer, "%016" PRIx64, value);
+		}
+	}
+
+	// Parses the whole value as a number in the base, or as a hexadecimal one if it has a "0x" prefix.
+	bool parse_number(const std::string& value, int base, uint64_t& result)
+	{
+		auto digits = value.c_str();
+		if (::has_hex_prefix(value))
+		{
+			digits += 2;
+			base = 16;
+		}
+		if (!std::isxdigit(static_cast<unsigned char>(*digits)))
+			return false;
+		char* end = nullptr;
+		errno = 0;
+		result = std::strtoull(digits, &end, base);
+		return !*end && errno == 0;
+	}
+
+	int compare(const char* lhs, size_t lhs_size, const char* rhs, size_t rhs_size)
+	{
+		const auto result = ::memcmp(lhs, rhs, std::min(lhs_size, rhs_size));
+		return result ? result : (lhs_size > rhs_size) - (lhs_size < rhs_size);
+	}
+}
+
+Table::Cell::Cell(const char* text)
+	: _text(text)
+	, _size(::strlen(text))
+{
+}
+
 Table::Table(std::vector<ColumnHeader>&& header)
 {
-	_header.reserve(header.size());
-	_alignment.reserve(header.size());
+	_columns.reserve(header.size());
 	for (auto& column : header)
 	{
 		if (!column.name.empty())
 			_empty_header = false;
-		_header.emplace_back(std::move(column.name));
-		_alignment.emplace_back(std::move(column.alignment));
+		_columns.emplace_back();
+		_columns.back().name = std::move(column.name);
+		_columns.back().alignment = column.alignment;
+		_columns.back().format = column.format;
+		_columns.back().formatter = std::move(column.formatter);
 	}
 }
 
 void Table::filter(const std::string& prefix, const std::string& value, Pass pass)
 {
-	const auto column = match_column(prefix);
-	if (column == _header.size())
+	const auto column_index = match_column(prefix);
+	if (column_index == _columns.size())
 		return;
+	const auto& column = _columns[column_index];
+
+	// Text matches ignore the "0x" prefix of hexadecimal values, which isn't printed.
+	uint64_t number = 0;
+	const auto compare_numbers = ::is_numeric(column.format) && ::parse_number(value, ::is_hex(column.format) ? 16 : 10, number)
+		&& pass != Pass::Containing && pass != Pass::StartingWith && pass != Pass::EndingWith;
+	const auto& text = ::is_hex(column.format) && ::has_hex_prefix(value) ? value.substr(2) : value;
+
 	size_t next_index = 0;
 	for (const auto row : _indices)
 	{
-		const auto& cell = _data[row][column];
+		int comparison = 0;
+		char buffer[21];
+		Text cell{nullptr, 0};
+		if (compare_numbers)
+			comparison = (column.values[row] > number) - (column.values[row] < number);
+		else
+		{
+			cell = cell_text(column, row, buffer);
+			comparison = ::compare(cell.data, cell.size, text.data(), text.size());
+		}
 		bool passed = false;
 		switch (pass)
 		{
 		case Pass::Equal:
-			passed = cell == value;
+			passed = comparison == 0;
 			break;
 		case Pass::NotEqual:
-			passed = cell != value;
+			passed = comparison != 0;
 			break;
 		case Pass::Less:
-			passed = (_alignment[column] == Table::Alignment::Right && cell.size() != value.size())
-				? cell.size() < value.size()
-				: cell < value;
+			passed = comparison < 0;
 			break;
 		case Pass::LessOrEqual:
-			passed = (_alignment[column] == Table::Alignment::Right && cell.size() != value.size())
-				? cell.size() < value.size()
-				: cell <= value;
+			passed = comparison <= 0;
 			break;
 		case Pass::Greater:
-			passed = (_alignment[column] == Table::Alignment::Right && cell.size() != value.size())
-				? cell.size() > value.size()
-				: cell > value;
+			passed = comparison > 0;
 			break;
 		case Pass::GreaterOrEqual:
-			passed = (_alignment[column] == Table::Alignment::Right && cell.size() != value.size())
-				? cell.size() > value.size()
-				: cell >= value;
+			passed = comparison >= 0;
 			break;
 		case Pass::Containing:
-			passed = cell.find(value) != std::string::npos;
+			passed = std::search(cell.data, cell.data + cell.size, text.begin(), text.end()) != cell.data + cell.size || text.empty();
 			break;
 		case Pass::StartingWith:
-			passed = cell.find(value) == 0;
+			passed = cell.size >= text.size() && ::memcmp(cell.data, text.data(), text.size()) == 0;
 			break;
 		case Pass::EndingWith:
-			passed = cell.size() >= value.size() && cell.find(value) == cell.size() - value.size();
+			passed = cell.size >= text.size() && ::memcmp(cell.data + cell.size - text.size(), text.data(), text.size()) == 0;
 			break;
 		}
 		if (passed)
@@ -88,12 +165,30 @@ void Table::leave_last_rows(size_t count)
 
 void Table::print(std::ostream& stream) const
 {
-	std::vector<size_t> widths(_header.size(), 0);
-	for (size_t i = 0; i < _header.size(); ++i)
-		widths[i] = std::max(widths[i], _header[i].size());
-	for (const auto& row : _data)
-		for (size_t i = 0; i < row.size(); ++i)
-			widths[i] = std::max(widths[i], row[i].size());
+	// Only the rows left after filtering are measured and formatted.
+	std::vector<size_t> widths(_columns.size(), 0);
+	for (size_t i = 0; i < _columns.size(); ++i)
+	{
+		const auto& column = _columns[i];
+		auto& width = widths[i];
+		width = column.name.size();
+		if (::is_numeric(column.format))
+		{
+			// Longer numbers are never formatted shorter, so the largest one is the widest.
+			uint64_t max_value = 0;
+			for (const auto row : _indices)
+				max_value = std::max(max_value, column.values[row]);
+			char buffer[21];
+			if (!_indices.empty())
+				width = std::max(width, ::format_number(column.format, max_value, buffer));
+			continue;
+		}
+		for (const auto row : _indices)
+		{
+			char buffer[21];
+			width = std::max(width, cell_text(column, row, buffer).size);
+		}
+	}
 
 	static const size_t column_spacing = 2;
 
@@ -104,23 +199,24 @@ void Table::print(std::ostream& stream) const
 	std::string buffer(1 + total_width + 1, ' ');
 	buffer.front() = '\t';
 	buffer.back() = '\n';
-	const auto print_row = [this, &stream, &widths, &buffer](const std::vector<std::string>& row)
+	const auto print_row = [this, &stream, &widths, &buffer](const auto& cell_at)
 	{
 		size_t offset = 1;
-		for (size_t i = 0; i < row.size(); ++i)
+		for (size_t i = 0; i < _columns.size(); ++i)
 		{
-			const auto& cell = row[i];
+			char number_buffer[21];
+			const auto cell = cell_at(i, number_buffer);
 			const auto column_width = widths[i];
-			const auto padding = column_width - cell.size();
-			if (_alignment[i] == Table::Alignment::Left)
+			const auto padding = column_width - cell.size;
+			if (_columns[i].alignment == Table::Alignment::Left)
 			{
-				::memcpy(&buffer[offset], cell.data(), cell.size());
-				::memset(&buffer[offset + cell.size()], ' ', padding);
+				::memcpy(&buffer[offset], cell.data, cell.size);
+				::memset(&buffer[offset + cell.size], ' ', padding);
 			}
 			else
 			{
 				::memset(&buffer[offset], ' ', padding);
-				::memcpy(&buffer[offset + padding], cell.data(), cell.size());
+				::memcpy(&buffer[offset + padding], cell.data, cell.size);
 			}
 			offset += column_width + column_spacing;
 		}
@@ -128,59 +224,100 @@ void Table::print(std::ostream& stream) const
 	};
 
 	if (!_empty_header)
-		print_row(_header);
+		print_row([this](size_t column, char (&)[21]) { return Text{_columns[column].name.data(), _columns[column].name.size()}; });
 	for (const auto row : _indices)
-		print_row(_data[row]);
+		print_row([this, row](size_t column, char (&number_buffer)[21]) { return cell_text(_columns[column], row, number_buffer); });
 }
 
-void Table::push_back(std::vector<std::string>&& row)
+void Table::push_back(std::initializer_list<Cell> row)
 {
-	assert(row.size() == _header.size());
-	_indices.emplace_back(_data.size());
-	_data.emplace_back(std::move(row));
+	assert(row.size() == _columns.size());
+	auto column = _columns.begin();
+	for (const auto& cell : row)
+	{
+		assert(cell._is_number == (::is_numeric(column->format) || column->format == Format::Function));
+		switch (column->format)
+		{
+		case Format::String:
+			column->text.append(cell._text, cell._size);
+			column->values.emplace_back(column->text.size());
+			break;
+		case Format::Enum:
+			{
+				const auto i = std::find_if(column->enum_values.begin(), column->enum_values.end(), [&cell](const std::string& value)
+				{
+					return value.size() == cell._size && ::memcmp(value.data(), cell._text, cell._size) == 0;
+				});
+				column->values.emplace_back(i - column->enum_values.begin());
+				if (i == column->enum_values.end())
+					column->enum_values.emplace_back(cell._text, cell._size);
+			}
+			break;
+		case Format::Hex32:
+			column->values.emplace_back(static_cast<uint32_t>(cell._number));
+			break;
+		default:
+			column->values.emplace_back(cell._number);
+		}
+		++column;
+	}
+	_indices.emplace_back(_row_count);
+	++_row_count;
 }
 
 void Table::reserve(size_t rows)
 {
-	_data.reserve(rows);
+	for (auto& column : _columns)
+		column.values.reserve(rows);
 	_indices.reserve(rows);
 }
 
 void Table::reverse_sort(const std::string& prefix)
 {
-	const auto column = match_column(prefix);
-	if (column == _header.size())
-		return;
-	std::sort(_indices.begin(), _indices.end(), [this, column](const auto lhs_row, const auto rhs_row)
-	{
-		const auto& lhs_cell = _data[lhs_row][column];
-		const auto& rhs_cell = _data[rhs_row][column];
-		if (_alignment[column] == Table::Alignment::Right && lhs_cell.size() != rhs_cell.size())
-			return lhs_cell.size() > rhs_cell.size();
-		return lhs_cell > rhs_cell;
-	});
+	sort_rows(prefix, true);
 }
 
 void Table::set_original()
 {
 	_indices.clear();
-	for (size_t row = 0; row < _data.size(); ++row)
+	for (size_t row = 0; row < _row_count; ++row)
 		_indices.emplace_back(row);
 }
 
 void Table::sort(const std::string& prefix)
 {
-	const auto column = match_column(prefix);
-	if (column == _header.size())
-		return;
-	std::sort(_indices.begin(), _indices.end(), [this, column](const auto lhs_row, const auto rhs_row)
+	sort_rows(prefix, false);
+}
+
+Table::Text Table::cell_text(const Column& column, size_t row, char (&buffer)[21])
+{
+	switch (column.format)
 	{
-		const auto& lhs_cell = _data[lhs_row][column];
-		const auto& rhs_cell = _data[rhs_row][column];
-		if (_alignment[column] == Table::Alignment::Right && lhs_cell.size() != rhs_cell.size())
-			return lhs_cell.size() < rhs_cell.size();
-		return lhs_cell < rhs_cell;
-	});
+	case Format::String:
+		{
+			const auto begin = row ? column.values[row - 1] : 0;
+			return {column.text.data() + begin, column.values[row] - begin};
+		}
+	case Format::Enum:
+		{
+			const auto& value = column.enum_values[column.values[row]];
+			return {value.data(), value.size()};
+		}
+	case Format::Function:
+		if (column.formatted.size() < column.values.size())
+		{
+			column.formatted.resize(column.values.size());
+			column.is_formatted.resize(column.values.size(), false);
+		}
+		if (!column.is_formatted[row])
+		{
+			column.formatted[row] = column.formatter(column.values[row]);
+			column.is_formatted[row] = true;
+		}
+		return {column.formatted[row].data(), column.formatted[row].size()};
+	default:
+		return {buffer, ::format_number(column.format, column.values[row], buffer)};
+	}
 }
 
 size_t Table::match_column(std::string prefix) const
@@ -188,14 +325,59 @@ size_t Table::match_column(std::string prefix) const
 	for (auto& c : prefix)
 		c = std::toupper(c);
 	size_t best_match_size = 0;
-	size_t best_match_index = _header.size();
-	for (const auto& column : _header)
+	size_t best_match_index = _columns.size();
+	for (const auto& column : _columns)
 	{
-		if (column.find(prefix) == 0 && prefix.size() > best_match_size)
+		if (column.name.find(prefix) == 0 && prefix.size() > best_match_size)
 		{
 			best_match_size = prefix.size();
-			best_match_index = &column - &_header.front();
+			best_match_index = &column - &_columns.front();
 		}
 	}
 	return best_match_index;
 }
+
+void Table::sort_rows(const std::string& prefix, bool reverse)
+{
+	const auto column_index = match_column(prefix);
+	if (column_index == _columns.size())
+		return;
+	const auto& column = _columns[column_index];
+
+	const auto sort_by = [this, reverse](const auto& less)
+	{
+		if (reverse)
+			std::sort(_indices.begin(), _indices.end(), [&less](size_t lhs_row, size_t rhs_row) { return less(rhs_row, lhs_row); });
+		else
+			std::sort(_indices.begin(), _indices.end(), less);
+	};
+
+	switch (column.format)
+	{
+	case Format::String:
+	case Format::Function:
+		sort_by([&column](size_t lhs_row, size_t rhs_row)
+		{
+			char buffer[21];
+			const auto lhs_cell = cell_text(column, lhs_row, buffer);
+			const auto rhs_cell = cell_text(column, rhs_row, buffer);
+			return ::compare(lhs_cell.data, lhs_cell.size, rhs_cell.data, rhs_cell.size) < 0;
+		});
+		break;
+	case Format::Enum:
+		{
+			// Enum values are compared by their ranks among the sorted values.
+			std::vector<size_t> order(column.enum_values.size());
+			for (size_t i = 0; i < order.size(); ++i)
+				order[i] = i;
+			std::sort(order.begin(), order.end(), [&column](size_t lhs, size_t rhs) { return column.enum_values[lhs] < column.enum_values[rhs]; });
+			std::vector<size_t> ranks(order.size());
+			for (size_t i = 0; i < order.size(); ++i)
+				ranks[order[i]] = i;
+			sort_by([&column, &ranks](size_t lhs_row, size_t rhs_row) { return ranks[column.values[lhs_row]] < ranks[column.values[rhs_row]]; });
+		}
+		break;
+	default:
+		sort_by([&column](size_t lhs_row, size_t rhs_row) { return column.values[lhs_row] < column.values[rhs_row]; });
+	}
+}
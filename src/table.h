@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
 #include <iosfwd>
 #include <string>
 #include <vector>
@@ -14,13 +17,52 @@ public:
 		Right,
 	};
 
+	// Numeric cells are stored as numbers and formatted only when printed.
+	enum class Format
+	{
+		String,
+		Enum,     // Strings from a small set, each stored once.
+		Decimal,
+		Hex,      // Without leading zeros.
+		Hex32,    // Eight digits.
+		Hex64,    // Sixteen digits.
+		Function, // Text made from a number by the column formatter when the cell is first printed or matched.
+	};
+
+	// Makes the text of a Function cell. Called only for the cells that are needed, at most once per cell.
+	using Formatter = std::function<std::string(uint64_t)>;
+
+	// Fixed-width hexadecimal format for addresses in a dump of the specified bitness.
+	static Format address(bool is_32bit) { return is_32bit ? Format::Hex32 : Format::Hex64; }
+
 	struct ColumnHeader
 	{
 		std::string name;
 		Alignment alignment = Alignment::Left;
+		Format format = Format::String;
+		Formatter formatter;
 
 		ColumnHeader(const std::string& name) : name(name) {}
 		ColumnHeader(const std::string& name, Alignment alignment) : name(name), alignment(alignment) {}
+		ColumnHeader(const std::string& name, Format format)
+			: name(name), alignment(format == Format::Decimal || format == Format::Hex ? Alignment::Right : Alignment::Left), format(format) {}
+		ColumnHeader(const std::string& name, Formatter&& formatter) : name(name), format(Format::Function), formatter(std::move(formatter)) {}
+	};
+
+	// A number for a numeric or Function column, or a string for a string column.
+	// Strings are referenced rather than copied, so cells must not outlive the push_back call.
+	class Cell
+	{
+	public:
+		Cell(uint64_t number) : _number(number), _is_number(true) {}
+		Cell(const char* text);
+		Cell(const std::string& text) : _text(text.data()), _size(text.size()) {}
+	private:
+		friend Table;
+		uint64_t _number = 0;
+		const char* _text = nullptr;
+		size_t _size = 0;
+		bool _is_number = false;
 	};
 
 	enum class Pass
@@ -38,14 +80,15 @@ public:
 
 	Table(std::vector<ColumnHeader>&&);
 
+	// Numeric columns are compared as numbers if the value is a number in the column radix or has a "0x" prefix.
 	void filter(const std::string& prefix, const std::string& value, Pass pass);
 	void leave_first_rows(size_t count);
 	void leave_last_rows(size_t count);
 	void print(std::ostream&) const;
-	void push_back(std::vector<std::string>&& row);
+	void push_back(std::initializer_list<Cell> row);
 	void reserve(size_t rows);
 	void reverse_sort(const std::string& prefix);
-	auto rows() const { return _data.size(); }
+	auto rows() const { return _row_count; }
 	void set_original();
 	void sort(const std::string& prefix);
 
@@ -57,13 +100,36 @@ public:
 
 private:
 
+	// Cells are stored column-wise. String cells are stored back to back in a single buffer.
+	struct Column
+	{
+		std::string name;
+		Alignment alignment = Alignment::Left;
+		Format format = Format::String;
+		std::vector<uint64_t> values; // Numbers, enum value indices or string cell ends.
+		std::string text;
+		std::vector<std::string> enum_values;
+		Formatter formatter;
+		mutable std::vector<std::string> formatted; // Function cell texts, allocated when the first one is made.
+		mutable std::vector<bool> is_formatted;
+	};
+
+	struct Text
+	{
+		const char* data;
+		size_t size;
+	};
+
+	// Returns the text of the cell, formatting numbers into the buffer.
+	static Text cell_text(const Column&, size_t row, char (&buffer)[21]);
+
 	size_t match_column(std::string prefix) const;
+	void sort_rows(const std::string& prefix, bool reverse);
 
 private:
 
 	bool _empty_header = true;
-	std::vector<std::string> _header;
-	std::vector<Alignment> _alignment;
-	std::vector<std::vector<std::string>> _data;
+	std::vector<Column> _columns;
+	size_t _row_count = 0;
 	std::vector<size_t> _indices;
 };
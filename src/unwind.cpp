@@ -0,0 +1,297 @@
+#include "unwind.h"
+#include "scan.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	namespace unwind
+	{
+		// Unwind information header (UNWIND_INFO), followed by unwind codes.
+		struct Info
+		{
+			uint8_t version_and_flags;
+			uint8_t prolog_size;
+			uint8_t code_count;
+			uint8_t frame_register_and_offset;
+
+			static constexpr uint8_t ChainInfo = 0x4; // (UNW_FLAG_CHAININFO).
+		};
+
+		// Unwind operation codes (UWOP_*).
+		enum : uint8_t
+		{
+			PushNonvolatile = 0,
+			AllocLarge = 1,
+			AllocSmall = 2,
+			SetFramePointer = 3,
+			SaveNonvolatile = 4,
+			SaveNonvolatileFar = 5,
+			Epilog = 6, // Version 2 only.
+			Spare = 7,
+			SaveXmm128 = 8,
+			SaveXmm128Far = 9,
+			PushMachineFrame = 10,
+		};
+
+		// Returns the number of 16-bit slots occupied by the unwind code.
+		unsigned code_slots(uint8_t operation, uint8_t info)
+		{
+			switch (operation)
+			{
+			case AllocLarge: return info == 0 ? 2 : 3;
+			case SaveNonvolatile: return 2;
+			case SaveNonvolatileFar: return 3;
+			case Epilog: return 2;
+			case SaveXmm128: return 2;
+			case SaveXmm128Far: return 3;
+			default: return 1;
+			}
+		}
+	}
+
+	// Longest call instruction recognized before a return address (CALL r/m32 with SIB and 32-bit displacement).
+	constexpr size_t MaxCallSize = 7;
+
+	// Checks whether the code preceding a return address ends with a call instruction.
+	bool follows_call(const uint8_t (&code)[MaxCallSize])
+	{
+		if (code[MaxCallSize - 5] == 0xe8) // CALL rel32.
+			return true;
+		for (size_t size = 2; size <= MaxCallSize; ++size)
+		{
+			// CALL r/m (FF /2) or CALL m16:32 (FF /3), optionally with a REX prefix which doesn't change the size check.
+			const auto instruction = code + MaxCallSize - size;
+			if (instruction[0] != 0xff)
+				continue;
+			const auto modrm = instruction[1];
+			const auto operation = (modrm >> 3) & 0x7;
+			if (operation != 2 && operation != 3)
+				continue;
+			const auto mod = modrm >> 6;
+			const auto rm = modrm & 0x7;
+			size_t expected_size = 2;
+			if (mod != 3 && rm == 4)
+			{
+				if (size < 3)
+					continue;
+				++expected_size; // SIB byte.
+				if (mod == 0 && (instruction[2] & 0x7) == 5)
+					expected_size += 4;
+			}
+			if (mod == 0 && rm == 5)
+				expected_size += 4; // Absolute or RIP-relative address.
+			else if (mod == 1)
+				expected_size += 1;
+			else if (mod == 2)
+				expected_size += 4;
+			if (expected_size == size)
+				return true;
+		}
+		return false;
+	}
+
+	// Protects from loops caused by corrupted function tables.
+	constexpr unsigned MaxChainDepth = 32;
+
+	class Unwinder
+	{
+	public:
+
+		Unwinder(const MinidumpData& dump, const MinidumpData::Thread& thread)
+			: _dump(dump), _thread(thread), _stack(thread.stack.data()) {}
+
+		// Restores the caller's registers, returns false if the frame can't be unwound.
+		bool unwind(uint64_t& rip, uint64_t (&registers)[16], bool is_return_address) const
+		{
+			using Context = MinidumpData::Context;
+
+			// Return addresses may point past the end of the calling function (e.g. after a call to a noreturn function).
+			const auto code_address = is_return_address ? rip - 1 : rip;
+			const auto module_index = _dump.module_index.find(code_address);
+			if (module_index >= _dump.modules.size())
+				return false;
+			const auto image_base = _dump.modules[module_index].image_base;
+			const auto rva = static_cast<uint32_t>(code_address - image_base);
+
+			auto function_pointer = _dump.images.find_runtime_function(module_index, rva);
+			if (!function_pointer) // Leaf functions have no function table entries and don't touch the stack.
+				return pop(rip, registers[Context::Rsp]);
+
+			auto function = *function_pointer;
+			for (unsigned depth = 0; ; ++depth)
+			{
+				if (depth == MaxChainDepth)
+					return false;
+				unwind::Info info;
+				if (!_dump.memory_reader.read(image_base + function.unwind_info, info))
+					return false;
+				const auto version = info.version_and_flags & 0x7;
+				if (version != 1 && version != 2)
+					return false;
+				uint16_t codes[256];
+				if (!_dump.memory_reader.read(image_base + function.unwind_info + sizeof info, codes, info.code_count * sizeof *codes))
+					return false;
+
+				// Codes are listed in reverse prolog order, and those not executed yet are skipped.
+				const auto prolog_offset = rva - function.begin;
+				const auto frame_register = info.frame_register_and_offset & 0xf;
+				const auto frame_offset = (info.frame_register_and_offset >> 4) * 16u;
+				auto& rsp = registers[Context::Rsp];
+				for (unsigned i = 0; i < info.code_count; )
+				{
+					const auto code_offset = static_cast<uint32_t>(codes[i] & 0xff);
+					const auto operation = static_cast<uint8_t>((codes[i] >> 8) & 0xf);
+					const auto operation_info = static_cast<uint8_t>(codes[i] >> 12);
+					const auto slots = unwind::code_slots(operation, operation_info);
+					if (i + slots > info.code_count)
+						return false;
+					const auto argument = codes + i + 1;
+					i += slots;
+					if (code_offset > prolog_offset)
+						continue;
+					switch (operation)
+					{
+					case unwind::PushNonvolatile:
+						if (!pop(registers[operation_info], rsp))
+							return false;
+						break;
+					case unwind::AllocLarge:
+						rsp += operation_info == 0 ? argument[0] * 8u : argument[0] | uint32_t{argument[1]} << 16;
+						break;
+					case unwind::AllocSmall:
+						rsp += operation_info * 8u + 8;
+						break;
+					case unwind::SetFramePointer:
+						rsp = registers[frame_register] - frame_offset;
+						break;
+					case unwind::SaveNonvolatile:
+						if (!read(rsp + argument[0] * 8u, registers[operation_info]))
+							return false;
+						break;
+					case unwind::SaveNonvolatileFar:
+						if (!read(rsp + (argument[0] | uint32_t{argument[1]} << 16), registers[operation_info]))
+							return false;
+						break;
+					case unwind::PushMachineFrame:
+						// The interrupted context is restored from the machine frame instead of a return address.
+						return read(rsp + (operation_info ? 8 : 0), rip)
+							&& read(rsp + (operation_info ? 32 : 24), rsp);
+					default:
+						break; // XMM registers aren't tracked, epilog codes only describe epilogs.
+					}
+				}
+
+				if (!(info.version_and_flags >> 3 & unwind::Info::ChainInfo))
+					break;
+				if (!_dump.memory_reader.read(image_base + function.unwind_info + sizeof info + ((info.code_count + 1) & ~1) * sizeof *codes, function))
+					return false;
+			}
+			return pop(rip, registers[Context::Rsp]);
+		}
+
+	private:
+
+		// Reads from the thread stack if possible, which is the common case.
+		bool read(uint64_t address, uint64_t& value) const
+		{
+			if (_stack && address >= _thread.stack_base && address <= _thread.stack_end - sizeof value)
+			{
+				::memcpy(&value, _stack + (address - _thread.stack_base), sizeof value);
+				return true;
+			}
+			return _dump.memory_reader.read(address, value);
+		}
+
+		bool pop(uint64_t& value, uint64_t& rsp) const
+		{
+			if (!read(rsp, value))
+				return false;
+			rsp += sizeof value;
+			return true;
+		}
+
+	private:
+		const MinidumpData& _dump;
+		const MinidumpData::Thread& _thread;
+		const uint8_t* const _stack;
+	};
+}
+
+std::vector<std::pair<uint64_t, uint64_t>> unwind_x64(const MinidumpData& dump, const MinidumpData::Thread& thread, const MinidumpData::Context& context, bool& complete)
+{
+	using Context = MinidumpData::Context;
+
+	std::vector<std::pair<uint64_t, uint64_t>> frames;
+	auto rip = context.x64.rip;
+	uint64_t registers[16];
+	std::copy(std::begin(context.x64.registers), std::end(context.x64.registers), registers);
+	frames.emplace_back(registers[Context::Rsp], rip);
+
+	const Unwinder unwinder(dump, thread);
+	complete = false;
+	while (frames.size() < MaxFrames)
+	{
+		const auto rsp = registers[Context::Rsp];
+		if (!unwinder.unwind(rip, registers, frames.size() > 1))
+			break;
+		if (!rip)
+		{
+			complete = true;
+			break;
+		}
+		if (registers[Context::Rsp] <= rsp)
+			break;
+		frames.emplace_back(registers[Context::Rsp], rip);
+	}
+	return frames;
+}
+
+std::vector<std::pair<uint64_t, uint64_t>> scan_stack(const MinidumpData& dump, const MinidumpData::Thread& thread, uint64_t address, bool check_calls)
+{
+	const auto stack = thread.stack.data();
+	if (!stack || dump.modules.empty())
+		return {};
+	const auto word_size = dump.is_32bit ? 4u : 8u;
+	address = std::max(address, thread.stack_base);
+	address += (word_size - address % word_size) % word_size;
+	if (address >= thread.stack_end)
+		return {};
+
+	// Vectorized filtering by the whole range of module addresses leaves few candidates to look up.
+	uint64_t low = UINT64_MAX;
+	uint64_t high = 0;
+	for (const auto& module : dump.modules)
+	{
+		low = std::min(low, module.image_base);
+		high = std::max(high, module.image_end);
+	}
+	std::vector<size_t> offsets;
+	const auto data = stack + (address - thread.stack_base);
+	::find_values(data, thread.stack_end - address, dump.is_32bit, low, high - low, offsets);
+
+	std::vector<uint64_t> values(offsets.size());
+	for (size_t i = 0; i < offsets.size(); ++i)
+		::memcpy(&values[i], data + offsets[i], word_size); // Upper half stays zero for 32-bit values.
+	std::vector<size_t> module_indices(values.size());
+	dump.module_index.find(values.data(), values.size(), module_indices.data());
+
+	std::vector<std::pair<uint64_t, uint64_t>> result;
+	for (size_t i = 0; i < values.size(); ++i)
+	{
+		const auto module_index = module_indices[i];
+		if (module_index >= dump.modules.size())
+			continue;
+		const auto value = values[i];
+		if (!dump.images.is_code(module_index, static_cast<uint32_t>(value - dump.modules[module_index].image_base)))
+			continue;
+		if (check_calls)
+		{
+			uint8_t code[MaxCallSize];
+			if (value >= MaxCallSize && dump.memory_reader.read(value - MaxCallSize, code, MaxCallSize) && !::follows_call(code))
+				continue;
+		}
+		result.emplace_back(address + offsets[i], value);
+	}
+	return result;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "minidump_data.h"
+
+// Maximum number of frames in a walked call chain. Protects from loops caused by corrupted stacks.
+constexpr size_t MaxFrames = 1024;
+
+// Walks the x64 stack of the thread from the context using function tables of loaded modules.
+// Returns stack and instruction pointers of each frame, starting with the context ones;
+// 'complete' is set to false if the walk stopped before reaching the outermost frame.
+std::vector<std::pair<uint64_t, uint64_t>> unwind_x64(const MinidumpData&, const MinidumpData::Thread&, const MinidumpData::Context&, bool& complete);
+
+// Scans thread stack words starting at the address for possible return addresses, i.e. ones pointing into code of loaded modules.
+// If 'check_calls' is set, candidates with captured code must also be preceded by a call instruction.
+// Returns stack addresses and values of the found words.
+std::vector<std::pair<uint64_t, uint64_t>> scan_stack(const MinidumpData&, const MinidumpData::Thread&, uint64_t address, bool check_calls);
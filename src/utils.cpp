@@ -1,10 +1,21 @@
 #include "utils.h"
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cinttypes>
 #include <cstring>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <unistd.h>
+
+uint64_t from_hex(const std::string& value)
+{
+	const auto digits = value.compare(0, 2, "0x") == 0 || value.compare(0, 2, "0X") == 0 ? value.substr(2) : value;
+	if (digits.empty() || digits.size() > 16 || digits.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)
+		throw std::runtime_error("Invalid hexadecimal number: " + value);
+	return std::stoull(digits, nullptr, 16);
+}
 
 std::string seconds_to_string(uint32_t duration)
 {
@@ -31,10 +42,15 @@ std::string time_t_to_string(time_t time)
 
 std::string to_ascii(const std::u16string& string)
 {
-	std::string ascii;
-	ascii.reserve(string.size());
-	for (const auto c : string)
-		ascii.push_back(c < 128 ? c : '?');
+	return ::to_ascii(string.data(), string.size());
+}
+
+std::string to_ascii(const char16_t* string, size_t size)
+{
+	std::string ascii(size, '?');
+	for (size_t i = 0; i < size; ++i)
+		if (string[i] < 128)
+			ascii[i] = string[i];
 	return ascii;
 }
 
@@ -59,6 +75,20 @@ std::string to_hex(uint64_t value)
 	return buffer.data();
 }
 
+std::string to_pdb_id(const uint8_t (&guid)[16], uint32_t age)
+{
+	uint32_t data1;
+	uint16_t data2;
+	uint16_t data3;
+	::memcpy(&data1, guid, sizeof data1);
+	::memcpy(&data2, guid + 4, sizeof data2);
+	::memcpy(&data3, guid + 6, sizeof data3);
+	std::array<char, 42> buffer;
+	::snprintf(buffer.data(), buffer.size(), "%08" PRIX32 "%04" PRIX16 "%04" PRIX16 "%02X%02X%02X%02X%02X%02X%02X%02X%" PRIX32,
+		data1, data2, data3, guid[8], guid[9], guid[10], guid[11], guid[12], guid[13], guid[14], guid[15], age);
+	return buffer.data();
+}
+
 std::string to_hex_min(uint64_t value)
 {
 	std::array<char, 17> buffer;
@@ -116,52 +146,75 @@ unsigned long to_ulong(const std::string& value)
 	}
 }
 
-void print_data(const uint32_t* data, size_t bytes, size_t columns)
+void print_data(std::ostream& stream, const uint32_t* data, size_t bytes, size_t columns)
 {
 	assert(columns > 0);
 	const auto size = bytes / sizeof *data;
 	for (size_t i = 0; i < size; ++i)
 	{
-		std::cout << (i % columns == 0 ? '\t' : ' ');
-		std::cout << std::hex << std::setfill('0') << std::setw(2 * sizeof *data) << data[i] << std::dec;
+		stream << (i % columns == 0 ? '\t' : ' ');
+		stream << std::hex << std::setfill('0') << std::setw(2 * sizeof *data) << data[i] << std::dec;
 		if ((i + 1) % columns == 0 || (i + 1) == size)
-			std::cout << std::endl;
+			stream << std::endl;
 	}
 }
 
-void print_data(uint32_t base, const uint32_t* data, size_t bytes, size_t columns)
+void print_data(std::ostream& stream, uint32_t base, const uint32_t* data, size_t bytes, size_t columns)
 {
 	assert(columns > 0);
 	const auto size = bytes / sizeof *data;
 	for (size_t i = 0; i < size; ++i)
 	{
 		if (i % columns == 0)
-			std::cout << '\t' << std::hex << std::setfill('0') << std::setw(2 * sizeof base) << (base + i * sizeof base) << " : ";
+			stream << '\t' << std::hex << std::setfill('0') << std::setw(2 * sizeof base) << (base + i * sizeof base) << " : ";
 		else
-			std::cout << ' ';
-		std::cout << std::hex << std::setfill('0') << std::setw(2 * sizeof *data) << data[i] << std::dec;
+			stream << ' ';
+		stream << std::hex << std::setfill('0') << std::setw(2 * sizeof *data) << data[i] << std::dec;
 		if ((i + 1) % columns == 0 || (i + 1) == size)
-			std::cout << std::endl;
+			stream << std::endl;
 	}
 }
 
-void print_data(uint64_t base, const uint64_t* data, size_t bytes, size_t columns)
+void print_data(std::ostream& stream, uint64_t base, const uint64_t* data, size_t bytes, size_t columns)
 {
 	assert(columns > 0);
 	const auto size = bytes / sizeof *data;
 	for (size_t i = 0; i < size; ++i)
 	{
 		if (i % columns == 0)
-			std::cout << '\t' << std::hex << std::setfill('0') << std::setw(2 * sizeof base) << (base + i * sizeof base) << " : ";
+			stream << '\t' << std::hex << std::setfill('0') << std::setw(2 * sizeof base) << (base + i * sizeof base) << " : ";
+		else
+			stream << ' ';
+		stream << std::hex << std::setfill('0') << std::setw(2 * sizeof *data) << data[i] << std::dec;
+		if ((i + 1) % columns == 0 || (i + 1) == size)
+			stream << std::endl;
+	}
+}
+
+void print_end_data(std::ostream& stream, uint32_t base, const uint32_t* data, size_t bytes, size_t columns)
+{
+	assert(columns > 0);
+	auto size = bytes / sizeof *data;
+	auto skip = columns - size % columns;
+	size += skip;
+	base -= skip * sizeof *data;
+	for (size_t i = 0; i < size; ++i)
+	{
+		if (i % columns == 0)
+			stream << '\t' << std::hex << std::setfill('0') << std::setw(2 * sizeof base) << (base + i * sizeof base) << " : ";
 		else
-			std::cout << ' ';
-		std::cout << std::hex << std::setfill('0') << std::setw(2 * sizeof *data) << data[i] << std::dec;
+			stream << ' ';
+		stream << std::setw(2 * sizeof *data);
+		if  (i < skip)
+			stream << std::setfill(' ') << "";
+		else
+			stream << std::hex << std::setfill('0') << data[i - skip] << std::dec;
 		if ((i + 1) % columns == 0 || (i + 1) == size)
-			std::cout << std::endl;
+			stream << std::endl;
 	}
 }
 
-void print_end_data(uint32_t base, const uint32_t* data, size_t bytes, size_t columns)
+void print_end_data(std::ostream& stream, uint64_t base, const uint64_t* data, size_t bytes, size_t columns)
 {
 	assert(columns > 0);
 	auto size = bytes / sizeof *data;
@@ -171,15 +224,37 @@ void print_end_data(uint32_t base, const uint32_t* data, size_t bytes, size_t co
 	for (size_t i = 0; i < size; ++i)
 	{
 		if (i % columns == 0)
-			std::cout << '\t' << std::hex << std::setfill('0') << std::setw(2 * sizeof base) << (base + i * sizeof base) << " : ";
+			stream << '\t' << std::hex << std::setfill('0') << std::setw(2 * sizeof base) << (base + i * sizeof base) << " : ";
 		else
-			std::cout << ' ';
-		std::cout << std::setw(2 * sizeof *data);
+			stream << ' ';
+		stream << std::setw(2 * sizeof *data);
 		if  (i < skip)
-			std::cout << std::setfill(' ') << "";
+			stream << std::setfill(' ') << "";
 		else
-			std::cout << std::hex << std::setfill('0') << data[i - skip] << std::dec;
+			stream << std::hex << std::setfill('0') << data[i - skip] << std::dec;
 		if ((i + 1) % columns == 0 || (i + 1) == size)
-			std::cout << std::endl;
+			stream << std::endl;
+	}
+}
+
+bool write_file(const std::string& path, const std::vector<uint8_t>& data)
+{
+	// The counter makes the name unique for concurrent writes within the process.
+	static std::atomic<unsigned> counter{0};
+	const auto temporary_path = path + '.' + std::to_string(::getpid()) + '.' + std::to_string(counter++) + ".tmp";
+	{
+		std::ofstream stream(temporary_path, std::ios::binary | std::ios::trunc);
+		stream.write(reinterpret_cast<const char*>(data.data()), data.size());
+		if (!stream.good() || (stream.close(), stream.fail()))
+		{
+			::unlink(temporary_path.c_str());
+			return false;
+		}
+	}
+	if (::rename(temporary_path.c_str(), path.c_str()) != 0)
+	{
+		::unlink(temporary_path.c_str());
+		return false;
 	}
+	return true;
 }
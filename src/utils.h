@@ -1,5 +1,6 @@
 #pragma once
 
+#include <iosfwd>
 #include <string>
 #include <vector>
 
@@ -17,6 +18,28 @@ constexpr bool has_flags(T value, std::underlying_type_t<T> flags)
 	return (value & flags) == flags;
 }
 
+// Initial value of a 64-bit FNV-1a hash.
+constexpr uint64_t Fnv1aBasis = 0xcbf29ce484222325;
+
+// Continues a 64-bit FNV-1a hash with the bytes of a value.
+inline uint64_t fnv1a(uint64_t hash, uint64_t value)
+{
+	for (int i = 0; i < 8; ++i, value >>= 8)
+		hash = (hash ^ (value & 0xff)) * 0x100000001b3;
+	return hash;
+}
+
+// Continues a 64-bit FNV-1a hash with the characters of a string.
+inline uint64_t fnv1a(uint64_t hash, const std::string& value)
+{
+	for (const auto c : value)
+		hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3;
+	return hash;
+}
+
+// Parses a hexadecimal number with an optional "0x" prefix.
+uint64_t from_hex(const std::string&);
+
 //
 std::string seconds_to_string(uint32_t);
 
@@ -25,6 +48,7 @@ std::string time_t_to_string(time_t);
 
 //
 std::string to_ascii(const std::u16string&);
+std::string to_ascii(const char16_t*, size_t);
 
 //
 std::string to_hex(uint16_t);
@@ -40,6 +64,9 @@ inline std::string to_hex(uint64_t value, bool as_uint32)
 //
 std::string to_hex_min(uint64_t);
 
+// Formats the PDB GUID and age as a symbol store identifier.
+std::string to_pdb_id(const uint8_t (&guid)[16], uint32_t age);
+
 //
 std::string to_human_readable(uint64_t);
 
@@ -57,11 +84,15 @@ std::string to_string(double);
 unsigned long to_ulong(const std::string&);
 
 //
-void print_data(const uint32_t* data, size_t bytes, size_t columns = 16);
+void print_data(std::ostream&, const uint32_t* data, size_t bytes, size_t columns = 16);
 
 //
-void print_data(uint32_t base, const uint32_t* data, size_t bytes, size_t columns = 16);
-void print_data(uint64_t base, const uint64_t* data, size_t bytes, size_t columns = 8);
+void print_data(std::ostream&, uint32_t base, const uint32_t* data, size_t bytes, size_t columns = 16);
+void print_data(std::ostream&, uint64_t base, const uint64_t* data, size_t bytes, size_t columns = 8);
 
 //
-void print_end_data(uint32_t base, const uint32_t* data, size_t bytes, size_t columns = 16);
+void print_end_data(std::ostream&, uint32_t base, const uint32_t* data, size_t bytes, size_t columns = 16);
+void print_end_data(std::ostream&, uint64_t base, const uint64_t* data, size_t bytes, size_t columns = 8);
+
+// Writes the file under a temporary name and renames it into place, so that it is replaced atomically.
+bool write_file(const std::string& path, const std::vector<uint8_t>& data);